@@ -1,34 +1,69 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <stdint.h>
 #include "csapp.h"
 
 #define MAX_CACHE_SIZE 1049000
 #define MAX_OBJECT_SIZE 102400
+#define SBUF_PER_WORKER 4 // 연결 대기열 크기 = 작업 스레드 수 * 4
+#define HASH_INITSIZE 1024 // 캐시 해시 테이블 초기 슬롯 수 (2의 거듭제곱)
 
-typedef struct cache_block {
-    char uri[MAXLINE];
-    char *data;
+typedef struct cache_block { // 삽입 후 불변. 캐시가 참조 1개, 전송 중인 스레드가 1개씩 보유
+    char *uri; // 블록 바로 뒤에 저장 (블록, uri, data를 malloc 한 번으로 할당)
+    uint64_t hash; // uri의 64비트 해시
+    char *data; // 원 서버 응답 그대로 (상태 줄 + 헤더 + 바디), 히트면 write 한 번으로 전송. uri 바로 뒤
     int size;
+    int charge; // 캐시 용량에서 차지하는 바이트 (블록 + uri + data)
+    int status; // 아래는 삽입 시 data에서 파싱한 메타데이터: 응답 상태 코드
+    int header_size; // 헤더 블록 길이 (빈 줄 포함, 바디는 data + header_size부터)
+    int content_type, content_type_len; // Content-Type 값의 data 안 위치와 길이 (없으면 길이 0)
+    int refcnt; // 참조 수 (원자적으로 증감, 0이 되면 해제)
     struct cache_block *prev, *next;
 } cache_block;
 
+typedef struct { // 해시 테이블 슬롯 (open addressing)
+    uint64_t hash; // 해시값을 먼저 비교해 strcmp를 대부분 생략
+    cache_block *blk; // NULL이면 빈 슬롯
+} hash_slot;
+
 cache_block *head = NULL, *tail = NULL;
 int cache_size = 0;
+hash_slot *table = NULL; // uri → 캐시 블록 인덱스
+size_t table_size = 0, table_count = 0; // 슬롯 수(2의 거듭제곱), 사용 중인 슬롯 수
 pthread_rwlock_t cache_lock;
 
+typedef struct { // 유한 크기 연결 대기열 (CS:APP sbuf)
+    int *buf; // 연결 fd 배열
+    int n; // 최대 슬롯 수
+    int front; // buf[(front+1)%n]이 첫 항목
+    int rear; // buf[rear%n]이 마지막 항목
+    sem_t mutex; // buf 접근 보호
+    sem_t slots; // 빈 슬롯 수
+    sem_t items; // 사용 가능한 항목 수
+} sbuf_t;
+
+sbuf_t sbuf; // prethread 모드의 연결 대기열
+
 static const char *user_agent_hdr =
     "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:10.0.3) Gecko/20120305 Firefox/10.0.3\r\n";
 
 void *thread(void *vargp);
+void *worker(void *vargp);
+void sbuf_init(sbuf_t *sp, int n);
+void sbuf_insert(sbuf_t *sp, int item);
+int sbuf_remove(sbuf_t *sp);
 void forward_request(int connfd);
 int parse_uri(char *uri, char *host, char *port, char *path);
 void cache_init();
 cache_block *cache_find(const char *uri);
 void cache_insert(const char *uri, const char *data, int size);
 void cache_evict(int needed_size);
+void cache_remove(cache_block *blk);
+void cache_release(cache_block *blk);
 
 int main(int argc, char **argv)
 {
@@ -36,14 +71,26 @@ int main(int argc, char **argv)
     socklen_t clientlen;
     struct sockaddr_storage clientaddr;
     pthread_t tid; // 스레드 식별값
+    int nworkers; // prethread 모드의 작업 스레드 수 (인자가 없으면 연결마다 스레드 생성)
 
-    if (argc != 2) { // port 번호를 입력하지 않았을 때 안내 메세지
-        fprintf(stderr, "usage: %s <port>\n", argv[0]); 
+    if (argc != 2 && argc != 3) { // port 번호를 입력하지 않았을 때 안내 메세지
+        fprintf(stderr, "usage: %s <port> [nworkers]\n", argv[0]); 
         exit(1);
     }
 
     cache_init(); // 캐시 초기화
     listenfd = Open_listenfd(argv[1]); // 포트 번호를 인자로 받아서 소켓을 열고, listenfd에 저장
+
+    if (argc == 3 && (nworkers = atoi(argv[2])) > 0) { // prethread 모드
+        sbuf_init(&sbuf, nworkers * SBUF_PER_WORKER); // 유한 크기 연결 대기열 생성
+        for (int i = 0; i < nworkers; i++)
+            pthread_create(&tid, NULL, worker, NULL); // 작업 스레드를 미리 생성
+        while (1) {
+            clientlen = sizeof(clientaddr);
+            sbuf_insert(&sbuf, Accept(listenfd, (SA *)&clientaddr, &clientlen)); // 대기열이 가득 차면 빈 슬롯이 생길 때까지 accept 중단 (back-pressure)
+        }
+    }
+
     while (1) {
         clientlen = sizeof(clientaddr); // 
         connfdp = malloc(sizeof(int)); // 새로운 connfd를 생성하기 위한 int 사이즈 메모리 블록 할당
@@ -63,6 +110,47 @@ void *thread(void *vargp)
     return NULL;
 }
 
+void *worker(void *vargp)
+{
+    pthread_detach(pthread_self()); // 작업 스레드는 종료되지 않지만 분리 상태로 둠
+    while (1) {
+        int connfd = sbuf_remove(&sbuf); // 대기열에서 연결 fd를 꺼냄 (비어 있으면 대기)
+        forward_request(connfd); // 클라이언트의 요청 처리
+        Close(connfd); // 클라이언트와의 연결 종료
+    }
+    return NULL;
+}
+
+void sbuf_init(sbuf_t *sp, int n)
+{
+    sp->buf = Calloc(n, sizeof(int)); // n개의 슬롯 할당
+    sp->n = n; // 최대 n개 항목
+    sp->front = sp->rear = 0; // front == rear 이면 빈 버퍼
+    Sem_init(&sp->mutex, 0, 1); // 상호 배제용 이진 세마포어
+    Sem_init(&sp->slots, 0, n); // 처음에는 n개 슬롯이 모두 비어 있음
+    Sem_init(&sp->items, 0, 0); // 처음에는 항목이 없음
+}
+
+void sbuf_insert(sbuf_t *sp, int item)
+{
+    P(&sp->slots); // 빈 슬롯 대기
+    P(&sp->mutex); // 버퍼 잠금
+    sp->buf[(++sp->rear) % (sp->n)] = item; // 항목 삽입
+    V(&sp->mutex); // 버퍼 해제
+    V(&sp->items); // 항목 생김을 알림
+}
+
+int sbuf_remove(sbuf_t *sp)
+{
+    int item;
+    P(&sp->items); // 항목 대기
+    P(&sp->mutex); // 버퍼 잠금
+    item = sp->buf[(++sp->front) % (sp->n)]; // 항목 꺼내기
+    V(&sp->mutex); // 버퍼 해제
+    V(&sp->slots); // 빈 슬롯 생김을 알림
+    return item;
+}
+
 void forward_request(int connfd)
 {
     rio_t client_rio, server_rio;
@@ -78,35 +166,37 @@ void forward_request(int connfd)
     if (parse_uri(uri, host, port, path) < 0) return; // URI 파싱 -> 호스트, 포트, 경로 정보 추출
 
     printf("[LOOKUP] %s\n", path);
-    pthread_rwlock_rdlock(&cache_lock); // 캐시 락을 읽기 모드로 잠금
+    pthread_rwlock_rdlock(&cache_lock); // 캐시 락을 읽기 모드로 잠금 (조회하는 동안만)
     cache_block *cb = cache_find(path); // 캐시에서 URI에 해당하는 블록 찾기
+    if (cb) __atomic_add_fetch(&cb->refcnt, 1, __ATOMIC_RELAXED); // 락을 풀기 전에 참조 획득
+    pthread_rwlock_unlock(&cache_lock); // 읽기 락 해제 → 전송 중에도 다른 스레드가 삽입/제거 가능
     if (cb) {
         printf("[HIT] %s\n", path);
-        Rio_writen(connfd, cb->data, cb->size); // 캐시에서 찾은 경우 클라이언트에게 데이터 전송
-        pthread_rwlock_unlock(&cache_lock); // 캐시에서 찾은 경우 읽기 락 해제
+        Rio_writen(connfd, cb->data, cb->size); // 락 없이 클라이언트에게 데이터 전송 (블록은 불변)
+        cache_release(cb); // 참조 반납 (그 사이 제거됐다면 여기서 해제)
         return;
     }
-    pthread_rwlock_unlock(&cache_lock); // 캐시에서 찾지 못한 경우 읽기 락 해제
 
-    sprintf(req, "GET %s HTTP/1.0\r\n", path);
-    while (Rio_readlineb(&client_rio, buf, MAXLINE) > 0 && strcmp(buf, "\r\n") != 0) { // 헤더 정보 읽기
+    // 요청 전체를 req 하나에 이어 붙임: 끝 위치(req_len)를 들고 다녀 매번 처음부터 길이를 세지 않는다 (strcat은 O(n^2))
+    int req_len = sprintf(req, "GET %s HTTP/1.0\r\n", path), line_len;
+    while ((line_len = Rio_readlineb(&client_rio, buf, MAXLINE)) > 0 && strcmp(buf, "\r\n") != 0) { // 헤더 정보 읽기
         if (strncasecmp(buf, "Host:", 5) == 0 ||            // 호스트 정보
             strncasecmp(buf, "User-Agent:", 11) == 0 ||     // 사용자 에이전트 정보
             strncasecmp(buf, "Connection:", 11) == 0 ||     // 연결 정보
             strncasecmp(buf, "Proxy-Connection:", 17) == 0) // 프록시 연결 정보
             continue;
-        strcat(req, buf);
+        if (req_len + line_len + MAXLINE >= sizeof(req)) return; // 아래 필수 헤더를 붙일 공간이 없으면 포기
+        memcpy(req + req_len, buf, line_len);
+        req_len += line_len;
     }
-    sprintf(buf, "Host: %s\r\n", host); strcat(req, buf); // 호스트 정보 추가
-    strcat(req, user_agent_hdr); // 사용자 에이전트 정보 추가
-    strcat(req, "Connection: close\r\n"); // 연결 정보 추가
-    strcat(req, "Proxy-Connection: close\r\n\r\n"); // 프록시 연결 정보 추가
+    req_len += snprintf(req + req_len, sizeof(req) - req_len, "Host: %s\r\n%sConnection: close\r\nProxy-Connection: close\r\n\r\n",
+                        host, user_agent_hdr); // 호스트, 사용자 에이전트, 연결 정보 추가
 
     int serverfd = Open_clientfd(host, port); // end 서버와 연결하기 위한 소켓 생성
     if (serverfd < 0) return; // 서버와 연결 실패 시 종료
 
     Rio_readinitb(&server_rio, serverfd); // 서버와 연결된 소켓에 대한 rio_t 구조체 초기화
-    Rio_writen(serverfd, req, strlen(req)); // 서버에 요청 전송
+    Rio_writen(serverfd, req, req_len); // 서버에 요청 전송 (write 한 번)
 
     char object_buf[MAX_OBJECT_SIZE]; // 캐시 저장을 위한 버퍼
     int total_size = 0, n; // 총 크기 및 읽은 바이트 수
@@ -154,39 +244,136 @@ void cache_init() {
     cache_size = 0; // 
 }
 
+uint64_t hash_uri(const char *uri) {
+    uint64_t h = 14695981039346656037ULL; // 64비트 FNV-1a
+    while (*uri) {
+        h ^= (unsigned char)*uri++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+size_t table_probe(const char *uri, uint64_t hash) {
+    size_t mask = table_size - 1;
+    size_t i = hash & mask; // 해시값으로 시작 슬롯 결정
+    while (table[i].blk && (table[i].hash != hash || strcmp(table[i].blk->uri, uri) != 0))
+        i = (i + 1) & mask; // 다른 키가 있으면 다음 슬롯 (linear probing)
+    return i; // uri가 있는 슬롯, 없으면 들어갈 빈 슬롯
+}
+
+void table_grow() {
+    hash_slot *old = table; // 기존 슬롯 배열
+    size_t old_size = table_size;
+    table_size = old_size ? old_size * 2 : HASH_INITSIZE; // 두 배로 확장
+    table = Calloc(table_size, sizeof(hash_slot));
+    for (size_t i = 0; i < old_size; i++)
+        if (old[i].blk) table[table_probe(old[i].blk->uri, old[i].hash)] = old[i]; // 새 배열에 다시 배치
+    free(old);
+}
+
+void table_remove(cache_block *blk) {
+    size_t mask = table_size - 1;
+    size_t i = table_probe(blk->uri, blk->hash), j = i;
+    if (!table[i].blk) return;
+    table[i].blk = NULL; // 슬롯 비우기
+    table_count--;
+    while (1) { // backward shift: 뒤따르는 슬롯을 당겨 탐색 경로가 끊기지 않게 함 (tombstone 불필요)
+        j = (j + 1) & mask;
+        if (!table[j].blk) return;
+        size_t home = table[j].hash & mask; // j 항목의 원래 시작 슬롯
+        if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j)) {
+            table[i] = table[j];
+            table[j].blk = NULL;
+            i = j;
+        }
+    }
+}
+
 cache_block *cache_find(const char *uri) {
-    cache_block *p = head; // 캐시 블록을 순회하기 위한 포인터
-    while (p) { // 캐시 블록을 순회
-        if (strcmp(p->uri, uri) == 0) return p; // URI가 일치하는 블록을 찾으면 반환
-        p = p->next; // 다음 블록으로 이동
+    if (!table_count) return NULL; // 캐시가 비어 있으면 바로 미스
+    return table[table_probe(uri, hash_uri(uri))].blk; // 해시 테이블에서 O(1) 조회
+}
+
+// 응답의 상태 줄과 헤더를 파싱해 blk의 메타데이터를 채움
+// 완전한 200 응답(헤더 끝이 있고 Content-Length가 있으면 바디가 그만큼 다 있음)이면 0, 캐시하지 않을 응답이면 -1
+static int parse_response_meta(cache_block *blk, const char *data, int size) {
+    const char *line, *eol, *end = data + size;
+    int content_length = -1;
+
+    // 상태 줄 "HTTP/x.y NNN": data는 NUL로 끝나지 않으므로 첫 줄 안에서 길이를 확인하며 읽음
+    if (!(eol = memchr(data, '\n', size)) || eol - data < 12 || memcmp(data, "HTTP/", 5) ||
+        !isdigit(data[5]) || data[6] != '.' || !isdigit(data[7]) || data[8] != ' ' ||
+        !isdigit(data[9]) || !isdigit(data[10]) || !isdigit(data[11]))
+        return -1;
+    blk->status = (data[9] - '0') * 100 + (data[10] - '0') * 10 + (data[11] - '0');
+    if (blk->status != 200) return -1;
+    blk->header_size = blk->content_type = blk->content_type_len = 0;
+    for (line = data; line < end && (eol = memchr(line, '\n', end - line)); line = eol + 1) { // 한 줄씩
+        if (eol - line <= 1 && line != data) { // 빈 줄: 헤더 끝
+            blk->header_size = eol + 1 - data;
+            break;
+        }
+        if (!strncasecmp(line, "Content-Length:", 15))
+            content_length = atoi(line + 15);
+        else if (!strncasecmp(line, "Content-Type:", 13)) {
+            const char *v = line + 13, *ve = eol;
+            while (v < ve && (*v == ' ' || *v == '\t')) v++; // 값 앞뒤 공백 제거
+            while (ve > v && (ve[-1] == '\r' || ve[-1] == ' ' || ve[-1] == '\t')) ve--;
+            blk->content_type = v - data;
+            blk->content_type_len = ve - v;
+        }
     }
-    return NULL;
+    if (!blk->header_size) return -1; // 헤더가 잘린 응답
+    if (content_length >= 0 && size - blk->header_size != content_length) return -1; // 바디가 잘린 응답
+    return 0;
 }
 
 void cache_insert(const char *uri, const char *data, int size) {
+    cache_block meta;
     if (size > MAX_OBJECT_SIZE) return; // 캐시 크기 제한 초과 시 삽입하지 않음
-    cache_evict(size); // 캐시 크기 조정
-    cache_block *blk = malloc(sizeof(cache_block)); // 새로운 캐시 블록 생성
-    blk->data = malloc(size); // 데이터 저장을 위한 메모리 할당
+    if (parse_response_meta(&meta, data, size) < 0) return; // 에러 응답이나 잘린 응답은 캐시하지 않음
+    cache_block *old = cache_find(uri);
+    if (old) cache_remove(old); // 같은 URI가 이미 있으면 새 블록으로 교체
+    int uri_len = strlen(uri) + 1;
+    meta.charge = sizeof(cache_block) + uri_len + size; // 메타데이터와 키도 용량에 포함
+    cache_evict(meta.charge); // 캐시 크기 조정
+    cache_block *blk = malloc(meta.charge); // 블록, URI, 데이터를 한 번에 할당 (단편화와 할당 횟수 감소)
+    *blk = meta; // 파싱한 메타데이터
+    blk->uri = (char *)(blk + 1);
+    memcpy(blk->uri, uri, uri_len); // URI 저장
+    blk->data = blk->uri + uri_len;
     memcpy(blk->data, data, size); // 데이터 복사
     blk->size = size; // 블록 크기 설정
-    strcpy(blk->uri, uri); // URI 저장
+    blk->refcnt = 1; // 캐시가 보유하는 참조
+    blk->hash = hash_uri(uri); // 해시 계산
+    if ((table_count + 1) * 2 > table_size) table_grow(); // 적재율 50% 초과 시 테이블 확장
+    table[table_probe(blk->uri, blk->hash)] = (hash_slot){blk->hash, blk}; // 인덱스에 등록
+    table_count++;
     blk->prev = NULL; // 이전 블록 포인터 초기화
     blk->next = head; // 다음 블록 포인터 설정
     if (head) head->prev = blk; // 기존 헤드 블록의 이전 포인터를 현재 블록으로 설정
     head = blk; // 새로운 블록을 헤드로 설정 
     if (!tail) tail = blk; // 처음 삽입 시 tail도 현재 블록으로 설정
-    cache_size += size; // 캐시 크기 업데이트
+    cache_size += blk->charge; // 캐시 크기 업데이트
 }
 
 void cache_evict(int needed_size) {
-    while (cache_size + needed_size > MAX_CACHE_SIZE && tail) { // 캐시 크기 조정
-        cache_block *old = tail; // 제거할 블록 포인터
-        cache_size -= old->size; // 캐시 크기 업데이트
-        if (old->prev) old->prev->next = NULL; // 이전 블록의 다음 포인터를 NULL로 설정
-        else head = NULL; // 제거할 블록이 헤드인 경우 헤드를 NULL로 설정
-        tail = old->prev; // tail을 이전 블록으로 설정
-        free(old->data); // 데이터 메모리 해제
-        free(old); // 블록 메모리 해제
+    while (cache_size + needed_size > MAX_CACHE_SIZE && tail) // 캐시 크기 조정
+        cache_remove(tail); // 가장 오래된 블록부터 제거
+}
+
+void cache_remove(cache_block *blk) {
+    cache_size -= blk->charge; // 캐시 크기 업데이트
+    table_remove(blk); // 인덱스에서 제거
+    if (blk->prev) blk->prev->next = blk->next; // 리스트에서 분리
+    else head = blk->next;
+    if (blk->next) blk->next->prev = blk->prev;
+    else tail = blk->prev;
+    cache_release(blk); // 캐시의 참조 반납 (전송 중인 스레드가 있으면 그쪽에서 해제)
+}
+
+void cache_release(cache_block *blk) {
+    if (__atomic_sub_fetch(&blk->refcnt, 1, __ATOMIC_ACQ_REL) == 0) { // 마지막 참조일 때만
+        free(blk); // 블록, URI, 데이터가 한 덩어리
     }
-}
\ No newline at end of file
+}
@@ -802,10 +802,8 @@ ssize_t rio_writen(int fd, void *usrbuf, size_t n)
  *    read() if the internal buffer is empty.
  */
 /* $begin rio_read */
-static ssize_t rio_read(rio_t *rp, char *usrbuf, size_t n)
+static ssize_t rio_fill(rio_t *rp)
 {
-    int cnt;
-
     while (rp->rio_cnt <= 0) {  /* Refill if buf is empty */
 	rp->rio_cnt = read(rp->rio_fd, rp->rio_buf, 
 			   sizeof(rp->rio_buf));
@@ -818,6 +816,16 @@ static ssize_t rio_read(rio_t *rp, char *usrbuf, size_t n)
 	else 
 	    rp->rio_bufptr = rp->rio_buf; /* Reset buffer ptr */
     }
+    return rp->rio_cnt;
+}
+
+static ssize_t rio_read(rio_t *rp, char *usrbuf, size_t n)
+{
+    int cnt;
+    ssize_t rc;
+
+    if ((rc = rio_fill(rp)) <= 0)
+	return rc;
 
     /* Copy min(n, rp->rio_cnt) bytes from internal buf to user buf */
     cnt = n;          
@@ -870,26 +878,71 @@ ssize_t rio_readnb(rio_t *rp, void *usrbuf, size_t n)
 /* $begin rio_readlineb */
 ssize_t rio_readlineb(rio_t *rp, void *usrbuf, size_t maxlen) 
 {
-    int n, rc;
-    char c, *bufp = usrbuf;
-
-    for (n = 1; n < maxlen; n++) { 
-        if ((rc = rio_read(rp, &c, 1)) == 1) {
-	    *bufp++ = c;
-	    if (c == '\n') {
-                n++;
-     		break;
-            }
-	} else if (rc == 0) {
-	    if (n == 1)
-		return 0; /* EOF, no data read */
-	    else
-		break;    /* EOF, some data was read */
-	} else
-	    return -1;	  /* Error */
+    size_t n = 0, cnt;
+    ssize_t rc;
+    char *nl, *bufp = usrbuf;
+
+    /* Scan the internal buffer with memchr and copy whole runs at once
+       instead of calling rio_read() once per byte */
+    while (n + 1 < maxlen) {
+	if ((rc = rio_fill(rp)) < 0)
+	    return -1;    /* Error */
+	if (rc == 0)
+	    break;        /* EOF */
+	cnt = rp->rio_cnt;
+	if (cnt > maxlen - 1 - n)
+	    cnt = maxlen - 1 - n;
+	if ((nl = memchr(rp->rio_bufptr, '\n', cnt)))
+	    cnt = nl - rp->rio_bufptr + 1;
+	memcpy(bufp + n, rp->rio_bufptr, cnt);
+	rp->rio_bufptr += cnt;
+	rp->rio_cnt -= cnt;
+	n += cnt;
+	if (nl)
+	    break;
+    }
+    if (maxlen > 0)
+	bufp[n] = 0;
+    return n;     /* 0: EOF, no data read */
+}
+
+/*
+ * rio_peeklineb - Zero-copy variant of rio_readlineb. Sets *linep to the
+ *    next line inside the internal buffer and returns its length
+ *    including the '\n' (the line is not NUL-terminated). The pointer
+ *    stays valid only until the next call on rp. A line longer than the
+ *    internal buffer is returned in RIO_BUFSIZE pieces. Returns 0 on EOF
+ *    and -1 on error.
+ */
+ssize_t rio_peeklineb(rio_t *rp, char **linep)
+{
+    char *nl = NULL;
+    ssize_t rc, n;
+
+    if (rp->rio_cnt < 0)
+	rp->rio_cnt = 0;
+    while (!rp->rio_cnt || !(nl = memchr(rp->rio_bufptr, '\n', rp->rio_cnt))) {
+	/* Partial line: move it to the front and read the rest after it */
+	if (rp->rio_cnt && rp->rio_bufptr != rp->rio_buf)
+	    memmove(rp->rio_buf, rp->rio_bufptr, rp->rio_cnt);
+	rp->rio_bufptr = rp->rio_buf;
+	if (rp->rio_cnt == sizeof(rp->rio_buf))
+	    break;        /* Line longer than the buffer */
+	rc = read(rp->rio_fd, rp->rio_buf + rp->rio_cnt, sizeof(rp->rio_buf) - rp->rio_cnt);
+	if (rc < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return -1;    /* Error */
+	}
+	if (rc == 0)
+	    break;        /* EOF */
+	rp->rio_cnt += rc;
     }
-    *bufp = 0;
-    return n-1;
+    n = nl ? nl - rp->rio_bufptr + 1 : rp->rio_cnt;
+    *linep = rp->rio_bufptr;
+    rp->rio_bufptr += n;
+    rp->rio_cnt -= n;
+    return n;
 }
 /* $end rio_readlineb */
 
@@ -0,0 +1,64 @@
+#!/usr/bin/python3
+
+# burst-client.py - Opens a burst of connections to the proxy at once,
+#                   sends one GET on each, and reports the time from
+#                   connect() to the first response byte (p50/p90/p99).
+#                   Used to compare --engine=thread and --engine=prethread.
+#
+# usage: burst-client.py <proxy port> <connections> <rounds> <url>
+#
+import select
+import socket
+import sys
+import time
+
+port, nconns, rounds, url = int(sys.argv[1]), int(sys.argv[2]), int(sys.argv[3]), sys.argv[4]
+request = ('GET %s HTTP/1.0\r\nHost: %s\r\n\r\n' % (url, url.split('/')[2])).encode()
+latency = []
+fails = 0
+
+for r in range(rounds):
+  # socket -> [connect start, request sent]
+  pending = {}
+  for i in range(nconns):
+    s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    s.setblocking(False)
+    start = time.perf_counter()
+    try:
+      s.connect(('127.0.0.1', port))
+    except BlockingIOError:
+      pass
+    pending[s] = [start, False]
+
+  while pending:
+    unsent = [s for s in pending if not pending[s][1]]
+    if unsent:
+      _, writable, _ = select.select([], unsent, [], 0)
+      for s in writable:
+        try:
+          s.send(request)
+          pending[s][1] = True
+        except OSError:
+          fails += 1
+          s.close()
+          del pending[s]
+    readable, _, _ = select.select([s for s in pending if pending[s][1]], [], [], 0.05)
+    now = time.perf_counter()
+    for s in readable:
+      try:
+        data = s.recv(65536)
+      except OSError:
+        data = b''
+      if data:
+        latency.append(now - pending[s][0])
+      else:
+        fails += 1
+      s.close()
+      del pending[s]
+
+if not latency:
+  sys.exit('no responses (%d failed)' % fails)
+latency.sort()
+pct = lambda p: latency[min(len(latency) - 1, int(p * len(latency)))] * 1000
+print('responses=%d failed=%d p50=%.2fms p90=%.2fms p99=%.2fms max=%.2fms' %
+      (len(latency), fails, pct(.5), pct(.9), pct(.99), latency[-1] * 1000))
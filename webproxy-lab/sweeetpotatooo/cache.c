@@ -1,120 +1,624 @@
 #include <stdio.h>
 #include "csapp.h"
 #include "cache.h"
+#include "disk.h"
+#include "outbuf.h"
+#include "policy.h"
+#include "slab.h"
+#include "snapshot.h"
 
-// 전역 변수: 캐시 연결 리스트의 시작과 끝, 전체 크기
-CachedObject *rootp;              // 가장 최근에 사용된 객체 (head of LRU)
-CachedObject *lastp;              // 가장 오래된 객체 (tail of LRU)
-int total_cache_size = 0;         // 현재 캐시에 저장된 전체 크기
+#define HASH_INITSIZE 256                        // 샤드별 해시 테이블 초기 슬롯 수 (2의 거듭제곱)
+#define SHARD_CACHE_SIZE (MAX_CACHE_SIZE / CACHE_SHARDS) // 샤드 하나의 용량
 
+_Static_assert((CACHE_SHARDS & (CACHE_SHARDS - 1)) == 0, "CACHE_SHARDS must be a power of two");
+_Static_assert(SHARD_CACHE_SIZE >= SLAB_LARGE_RESERVE(sizeof(CachedObject) + MAXLINE + MAXBUF + MAX_OBJECT_SIZE),
+               "each shard must fit the largest object with its key and headers");
+
+// 해시 테이블 슬롯: 해시값을 먼저 비교해 키 문자열 비교(strcmp)를 대부분 생략
+typedef struct
+{
+  uint64_t hash;
+  CachedObject *obj;  // NULL이면 빈 슬롯
+} HashSlot;
+
+// 독립적으로 잠기는 캐시 조각. 키 해시의 상위 비트로 선택한다.
+typedef struct
+{
+  pthread_mutex_t lock;       // 이 샤드의 정책 큐/테이블 보호 (조회/정책 갱신 동안만 짧게 잡음)
+  cache_policy_t policy;      // 교체 정책 상태 (어떤 객체를 남기고 버릴지)
+  int total_cache_size;       // 이 샤드에 저장된 전체 크기
+  HashSlot *table;            // 키 → 객체 인덱스 (open addressing, linear probing)
+  size_t table_size;          // 슬롯 수 (2의 거듭제곱)
+  size_t table_count;         // 사용 중인 슬롯 수
+} CacheShard;
+
+static CacheShard shards[CACHE_SHARDS];
+static const policy_ops_t *cache_policy = &policy_lru; // --cache-policy (기본 LRU)
+static cache_stats_t stats;                             // 원자적으로만 갱신
 
-// LRU 리스트는 rootp에서 시작해 lastp까지 이어지는 양방향 연결 리스트
-// read_cache()가 접근 시 root로 당기고, write_cache()는 새로 추가
-// 용량 초과 시 lastp부터 제거
 
+// 샤드마다 교체 정책(policy.c: LRU, W-TinyLFU, S3-FIFO)이 객체를 자신의 큐에 연결해 관리
+// find_cache()가 히트 시 정책에 알리고(access), write_cache()는 새로 추가(insert)
+// 샤드 용량 초과 시 정책이 고른 객체(victim)부터 제거
+// 조회는 해시 테이블로 O(1), 정책 큐는 객체에 내장된 prev/next로 O(1) 갱신
 
-// 클라이언트 요청 도착: find_cache()로 캐시 존재 여부 확인
-// 캐시 히트: send_cache()로 클라이언트에 전달 + read_cache()로 LRU 갱신
+
+// 클라이언트 요청 도착: find_cache()로 캐시 존재 여부 확인 (히트면 참조를 하나 얻음)
+// 캐시 히트: 락 없이 send_cache()로 클라이언트에 전달 → release_cache()로 참조 반납
 // 캐시 미스: 원 서버에서 응답 수신 → 조건 충족 시 write_cache()로 저장
-// 캐시 초과: write_cache() 내에서 자동으로 lastp 제거하며 용량 관리
+// 캐시 초과: write_cache() 내에서 자동으로 정책의 victim을 제거하며 용량 관리
 
 
-// 요청한 path에 해당하는 객체가 캐시에 있는지 탐색
-CachedObject *find_cache(char *path) 
+// 요청 대상 서버와 경로를 합쳐 캐시 키 생성 (같은 경로라도 서버가 다르면 다른 객체)
+void make_cache_key(char *key, char *hostname, char *port, char *path)
+{
+  snprintf(key, MAXLINE, "%s:%s%s", hostname, port, path);
+}
+
+// 신선도 정보 없이도 저장할 수 있는 상태 코드 (RFC 9110 15.1 heuristically cacheable)
+static int heuristic_status(int status)
+{
+  switch (status)
+  {
+  case 200: case 203: case 204: case 300: case 301: case 308:
+  case 404: case 405: case 410: case 414: case 501:
+    return 1;
+  }
+  return 0;
+}
+
+// 키와 응답(헤더 블록 header_length + 바디 content_length) 자리를 가진 빈 객체를 슬랩에서 한 번에 할당
+// [CachedObject][키 NUL][헤더 블록][바디] 순서로 이어져 있고, 캐시 용량은 실제로 잡힌 크기(reserved)로 센다
+CachedObject *cache_object_alloc(const char *key, int header_length, int content_length)
+{
+  size_t key_len = strlen(key) + 1, reserved;
+  CachedObject *Cache = slab_alloc(sizeof(CachedObject) + key_len + header_length + content_length, &reserved);
+
+  memset(Cache, 0, sizeof(CachedObject));
+  Cache->path = (char *)(Cache + 1);
+  memcpy(Cache->path, key, key_len);
+  Cache->response_ptr = Cache->path + key_len;
+  Cache->header_length = header_length;
+  Cache->content_length = content_length;
+  Cache->reserved = reserved;
+  return Cache;
+}
+
+// from 안을 가리키던 구간을 같은 내용을 복사한 to 안으로 옮김
+static http_slice_t rebase(http_slice_t s, char *from, char *to)
 {
-  if (!rootp)                     // 캐시가 비어 있다면 NULL 반환
+  if (s.len)
+    s.p = to + (s.p - from);
+  return s;
+}
+
+// 응답 헤더 블록에서 읽은 캐시 메타데이터와 신선 수명
+typedef struct
+{
+  int status;
+  http_slice_t content_type, etag, last_modified;
+  time_t now, date;
+  long lifetime, swr, sie;
+  int no_cache;
+} response_meta_t;
+
+// 헤더 블록(data, header_length)을 파싱해 m을 채우고 신선 수명을 계산 (RFC 9111 4.2)
+// 저장하면 안 되는 응답(no-store, private, 부분 응답, 신선도를 정할 수 없는 상태 코드)이면 -1
+static int parse_response_meta(char *data, int header_length, response_meta_t *m)
+{
+  char *line, *end = data + header_length, *eol;
+  http_header_t h;
+  long max_age = -1;
+  time_t expires = -1, lm;
+  int has_expires = 0;
+
+  memset(m, 0, sizeof(*m));
+  m->now = time(NULL);
+  m->date = -1;
+  // 상태 줄 "HTTP/x.y NNN": 헤더 블록은 NUL로 끝나지 않으므로(바디나 스냅샷 매핑이 이어짐) 첫 줄 안에서 길이를 확인하며 읽음
+  if (!(line = memchr(data, '\n', header_length)) || line - data < 12 || memcmp(data, "HTTP/", 5) ||
+      !isdigit(data[5]) || data[6] != '.' || !isdigit(data[7]) || data[8] != ' ' ||
+      !isdigit(data[9]) || !isdigit(data[10]) || !isdigit(data[11]))
+    return -1;
+  m->status = (data[9] - '0') * 100 + (data[10] - '0') * 10 + (data[11] - '0');
+  if (m->status < 200 || m->status == 206 || m->status == 304)
+    return -1;
+
+  // 상태 줄을 건너뛰고 헤더를 한 줄씩
+  for (line++; line < end; line = eol + 1)
+  {
+    if (!(eol = memchr(line, '\n', end - line)) || http_parse_header(line, eol + 1 - line, &h) <= 0)
+      break;
+    switch (h.id)
+    {
+    case HDR_CONTENT_TYPE:
+      m->content_type = h.value;
+      break;
+    case HDR_ETAG:
+      m->etag = h.value;
+      break;
+    case HDR_LAST_MODIFIED:
+      m->last_modified = h.value;
+      break;
+    case HDR_DATE:
+      m->date = http_parse_date(&h.value);
+      break;
+    case HDR_CACHE_CONTROL:
+      // 공유 캐시이므로 private도 저장하지 않는다. s-maxage가 max-age보다 우선
+      if (http_value_has(&h.value, "no-store") || http_value_has(&h.value, "private"))
+        return -1;
+      m->no_cache |= http_value_has(&h.value, "no-cache");
+      if ((max_age = http_value_param(&h.value, "s-maxage")) < 0)
+        max_age = http_value_param(&h.value, "max-age");
+      m->swr = http_value_param(&h.value, "stale-while-revalidate");
+      m->sie = http_value_param(&h.value, "stale-if-error");
+      break;
+    case HDR_EXPIRES:
+      has_expires = 1;
+      expires = http_parse_date(&h.value); // 잘못된 날짜("0" 등)는 이미 만료된 것으로 본다
+      break;
+    }
+  }
+
+  // 신선 수명: no-cache(매번 재검증) > max-age > Expires - Date > Last-Modified 휴리스틱 > 기본값
+  if (m->no_cache)
+    m->lifetime = 0;
+  else if (max_age >= 0)
+    m->lifetime = max_age;
+  else if (has_expires)
+    m->lifetime = expires < 0 ? 0 : expires - (m->date > 0 ? m->date : m->now);
+  else if (!heuristic_status(m->status))
+    return -1;
+  else if (m->last_modified.len && (lm = http_parse_date(&m->last_modified)) > 0)
+    m->lifetime = ((m->date > 0 ? m->date : m->now) - lm) / CACHE_HEURISTIC_FRACTION;
+  else
+    m->lifetime = CACHE_DEFAULT_TTL;
+  if (m->lifetime > CACHE_HEURISTIC_MAX && max_age < 0 && !has_expires)
+    m->lifetime = CACHE_HEURISTIC_MAX;
+  if (m->lifetime < 0)
+    m->lifetime = 0;
+  return 0;
+}
+
+// 바디를 받기 전에 헤더 블록만으로 저장 가능한 응답인지 판단 (cache_object_new가 NULL을 돌려줄 응답이면 0)
+int cache_storable(char *data, int header_length)
+{
+  response_meta_t m;
+
+  return parse_response_meta(data, header_length, &m) == 0;
+}
+
+// 헤더 블록과 바디가 이어진 data로 캐시 객체를 만들고, 헤더에서 메타데이터와 신선도를 계산
+// age: 원 서버 응답의 Age 헤더 값 (헤더 블록에서는 빠져 있음, 없으면 0)
+// 저장하면 안 되는 응답이면 NULL
+// 저장할 수 있으면 data를 슬랩 청크 하나(메타데이터 + 키 + 헤더 블록 + 바디)로 복사하므로 data는 항상 호출자 소유
+// 반환된 객체의 refcnt는 0 (write_cache 전에 1로 두면 호출자가 참조를 유지)
+CachedObject *cache_object_new(char *key, char *data, int header_length, int content_length, long age)
+{
+  CachedObject *Cache;
+  response_meta_t m;
+
+  if (parse_response_meta(data, header_length, &m) < 0)
     return NULL;
 
-  CachedObject *current = rootp; // LRU 맨 앞부터 탐색 시작
+  Cache = cache_object_alloc(key, header_length, content_length);
+  memcpy(Cache->response_ptr, data, header_length + content_length);
+  Cache->status = m.status;
+  Cache->content_type = rebase(m.content_type, data, Cache->response_ptr);
+  Cache->etag = rebase(m.etag, data, Cache->response_ptr);
+  Cache->last_modified = rebase(m.last_modified, data, Cache->response_ptr);
+
+  // 받은 시점의 나이: Age 헤더와 Date 이후 흐른 시간 중 큰 값
+  Cache->stored_at = m.now;
+  Cache->initial_age = (m.date > 0 && m.now - m.date > age) ? m.now - m.date : age;
+  Cache->expires = m.now - Cache->initial_age + m.lifetime;
+  Cache->stale_while_revalidate = m.no_cache || m.swr < 0 ? 0 : m.swr; // no-cache는 매번 재검증이 끝나야 응답 가능
+  Cache->stale_if_error = m.sie < 0 ? 0 : m.sie;
+  return Cache;
+}
+
+// 아직 신선하면 1 (원 서버에 묻지 않고 응답 가능)
+int cache_is_fresh(CachedObject *Cache)
+{
+  return time(NULL) < Cache->expires;
+}
+
+// 지금 이 객체의 나이 (Age 헤더 값)
+long cache_age(CachedObject *Cache)
+{
+  return Cache->initial_age + (time(NULL) - Cache->stored_at);
+}
+
+// 만료됐지만 stale-while-revalidate 기간 안이면 1 (사본으로 응답하고 갱신은 뒤에서)
+int cache_within_swr(CachedObject *Cache)
+{
+  return time(NULL) < Cache->expires + Cache->stale_while_revalidate;
+}
+
+// 만료됐지만 stale-if-error 기간 안이면 1 (원 서버가 에러를 주면 사본으로 응답)
+int cache_within_sie(CachedObject *Cache)
+{
+  return time(NULL) < Cache->expires + Cache->stale_if_error;
+}
+
+// 이 객체의 백그라운드 갱신을 맡음. 이미 다른 작업이 갱신 중이면 0
+int cache_begin_refresh(CachedObject *Cache)
+{
+  int expected = 0;
+
+  return __atomic_compare_exchange_n(&Cache->refreshing, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+// 갱신 작업 종료 (실패했으면 다음 요청이 다시 갱신을 맡을 수 있음)
+void cache_end_refresh(CachedObject *Cache)
+{
+  __atomic_store_n(&Cache->refreshing, 0, __ATOMIC_RELEASE);
+}
+
+// 헤더 줄 line의 이름이 블록 [p, end) 안의 어떤 헤더 이름과 같은지 (대소문자 무시)
+static int header_in_block(http_header_t *h, char *p, char *end)
+{
+  http_header_t o;
+  char *eol;
+
+  for (; p < end && (eol = memchr(p, '\n', end - p)); p = eol + 1)
+    if (http_parse_header(p, eol + 1 - p, &o) > 0 && o.name.len == h->name.len &&
+        !strncasecmp(o.name.p, h->name.p, h->name.len))
+      return 1;
+  return 0;
+}
+
+// 조건부 요청에 304로 답한 경우: 저장된 헤더를 304 응답의 헤더(hdrs, 상태 줄 포함)로 갱신한 새 객체 반환 (RFC 9111 4.3.4)
+// 바디와 상태 줄은 그대로, 같은 이름의 헤더는 304 쪽 값으로 바꾸고 나머지는 유지한다. 저장하면 안 되면 NULL
+CachedObject *cache_object_refresh(CachedObject *old, char *hdrs, int hdrs_len, long age)
+{
+  char *old_end = old->response_ptr + old->header_length, *new_end = hdrs + hdrs_len;
+  char *line, *eol, *nhdrs, *data;
+  int len;
+  http_header_t h;
+  CachedObject *Cache;
+
+  // 304 쪽 상태 줄은 건너뛴다 (Content-Length/Transfer-Encoding은 바디가 없는 304 기준이라 쓰지 않음)
+  nhdrs = memchr(hdrs, '\n', hdrs_len);
+  nhdrs = nhdrs ? nhdrs + 1 : new_end;
+
+  data = Malloc(old->header_length + hdrs_len + old->content_length + 1);
+  eol = memchr(old->response_ptr, '\n', old->header_length);
+  len = eol + 1 - old->response_ptr;
+  memcpy(data, old->response_ptr, len); // 저장된 상태 줄
+
+  for (line = eol + 1; line < old_end && (eol = memchr(line, '\n', old_end - line)); line = eol + 1)
+  {
+    if (http_parse_header(line, eol + 1 - line, &h) > 0 && h.id != HDR_CONTENT_LENGTH && header_in_block(&h, nhdrs, new_end))
+      continue;
+    memcpy(data + len, line, eol + 1 - line);
+    len += eol + 1 - line;
+  }
+  for (line = nhdrs; line < new_end && (eol = memchr(line, '\n', new_end - line)); line = eol + 1)
+  {
+    if (http_parse_header(line, eol + 1 - line, &h) > 0 && (h.id == HDR_CONTENT_LENGTH || h.id == HDR_TRANSFER_ENCODING))
+      continue;
+    memcpy(data + len, line, eol + 1 - line);
+    len += eol + 1 - line;
+  }
+  memcpy(data + len, old->response_ptr + old->header_length, old->content_length);
+
+  Cache = cache_object_new(old->path, data, len, old->content_length, age);
+  free(data);
+  return Cache;
+}
+
+// 64비트 FNV-1a 해시
+static uint64_t hash_key(const char *key)
+{
+  uint64_t h = 14695981039346656037ULL;
 
-  while (strcmp(current->path, path))  // 현재 노드의 path가 일치하지 않으면
+  while (*key)
   {
-    if (!current->next)          // 끝까지 갔는데 못 찾았으면 NULL 반환
-      return NULL;
+    h ^= (unsigned char)*key++;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// 디스크 계층이 같은 해시를 인덱스에 쓰도록 공개
+uint64_t cache_key_hash(const char *key)
+{
+  return hash_key(key);
+}
 
-    current = current->next;     // 다음 노드로 이동
+// 샤드는 상위 비트, 테이블 슬롯은 하위 비트를 사용해 서로 독립적으로 분산
+static CacheShard *shard_of(uint64_t hash)
+{
+  return &shards[(hash >> 32) & (CACHE_SHARDS - 1)];
+}
 
-    if (!strcmp(current->path, path))  // 일치하는 path를 찾으면 해당 객체 반환
-      return current;
+void cache_init(void)
+{
+  for (int i = 0; i < CACHE_SHARDS; i++)
+  {
+    pthread_mutex_init(&shards[i].lock, NULL);
+    policy_init(&shards[i].policy, cache_policy, SHARD_CACHE_SIZE);
   }
+}
+
+// key가 있는 슬롯, 없으면 key가 들어갈 빈 슬롯의 위치 반환
+static size_t probe(CacheShard *sp, const char *key, uint64_t hash)
+{
+  size_t mask = sp->table_size - 1;
+  size_t i = hash & mask;
 
-  return current;  // 루프를 빠져나왔다는 것은 처음 노드가 일치한 경우
+  while (sp->table[i].obj && (sp->table[i].hash != hash || strcmp(sp->table[i].obj->path, key)))
+    i = (i + 1) & mask;
+  return i;
 }
 
-// 클라이언트에게 캐시된 응답 데이터를 전송
-void send_cache(CachedObject *Cache, int clientfd)
+// 슬롯 배열을 두 배로 늘리고 모든 객체를 다시 배치
+static void table_grow(CacheShard *sp)
 {
-  char buf[MAXLINE];
+  HashSlot *old = sp->table;
+  size_t old_size = sp->table_size;
 
-  // 응답 헤더 구성
-  sprintf(buf, "HTTP/1.0 200 OK\r\n");
-  sprintf(buf, "%sServer: Tiny Web Server\r\n", buf);
-  sprintf(buf, "%sConnection: close\r\n", buf);
-  sprintf(buf, "%sContent-length: %d\r\n\r\n", buf, Cache->content_length);
+  sp->table_size = old_size ? old_size * 2 : HASH_INITSIZE;
+  sp->table = Calloc(sp->table_size, sizeof(HashSlot));
+  for (size_t i = 0; i < old_size; i++)
+    if (old[i].obj)
+      sp->table[probe(sp, old[i].obj->path, old[i].hash)] = old[i];
+  free(old);
+}
 
-  // 헤더 전송
-  Rio_writen(clientfd, buf, strlen(buf));
+// 객체를 인덱스에서 제거 (backward shift: tombstone 없이 뒤따르는 슬롯을 당겨 채움)
+static void table_remove(CacheShard *sp, CachedObject *Cache)
+{
+  size_t mask = sp->table_size - 1;
+  size_t i = probe(sp, Cache->path, Cache->hash);
+  size_t j = i;
 
-  // 응답 바디 전송
-  Rio_writen(clientfd, Cache->response_ptr, Cache->content_length);
+  if (!sp->table[i].obj)
+    return;
+  sp->table[i].obj = NULL;
+  sp->table_count--;
+
+  while (1)
+  {
+    j = (j + 1) & mask;
+    if (!sp->table[j].obj)
+      return;
+    // j의 원래 자리(home)가 (i, j] 구간 밖이면 i로 당겨도 탐색 경로가 끊기지 않음
+    size_t home = sp->table[j].hash & mask;
+    if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j))
+    {
+      sp->table[i] = sp->table[j];
+      sp->table[j].obj = NULL;
+      i = j;
+    }
+  }
 }
 
-// 접근한 캐시 객체를 리스트의 가장 앞 (root)로 이동 (LRU 정책 유지 목적)
-void read_cache(CachedObject *Cache)
+// 객체를 캐시에서 제거하고 캐시가 가진 참조를 반납 (전송 중인 사용자가 있으면 그쪽이 해제)
+// spill이 있고 디스크 계층이 켜져 있으면 신선한 객체는 참조를 쥔 채 *spill 목록에 이어 둔다
+// (샤드 락을 풀고 나서 디스크에 쓰고 반납, write_cache)
+static void evict(CacheShard *sp, CachedObject *Cache, CachedObject **spill)
 {
-  if (Cache == rootp) // 이미 가장 앞에 있는 경우는 무시
+  sp->total_cache_size -= Cache->reserved;  // 캐시 크기 감소 (실제로 잡힌 바이트)
+  table_remove(sp, Cache);
+  sp->policy.ops->remove(&sp->policy, Cache);
+  if (spill && disk_enabled() && cache_is_fresh(Cache))
+  {
+    Cache->next = *spill;  // 정책 큐에서 빠졌으므로 next를 목록 연결에 재사용
+    *spill = Cache;
     return;
+  }
+  release_cache(Cache);
+}
+
+// 샤드 락을 잡은 상태에서 key 조회
+static CachedObject *lookup(CacheShard *sp, const char *key, uint64_t hash)
+{
+  if (!sp->table_count)           // 샤드가 비어 있다면 NULL 반환
+    return NULL;
+  return sp->table[probe(sp, key, hash)].obj;
+}
+
+// 교체 정책 변경 (서버 시작 시). 모르는 이름이면 -1
+// 샤드마다 정책 상태를 새로 만들므로 저장된 객체는 모두 비운다
+int cache_set_policy(const char *name)
+{
+  const policy_ops_t *ops = policy_find(name);
+  CachedObject *Cache;
 
-  // 연결 해제: 현재 노드를 리스트에서 분리
-  if (Cache->next)  // 중간 노드인 경우
+  if (!ops)
+    return -1;
+  for (int i = 0; i < CACHE_SHARDS; i++)
   {
-    CachedObject *prev_objtect = Cache->prev;
-    CachedObject *next_objtect = Cache->next;
+    CacheShard *sp = &shards[i];
+
+    pthread_mutex_lock(&sp->lock);
+    while ((Cache = sp->policy.ops->victim(&sp->policy)))
+      evict(sp, Cache, NULL);
+    policy_free(&sp->policy);
+    policy_init(&sp->policy, ops, SHARD_CACHE_SIZE);
+    pthread_mutex_unlock(&sp->lock);
+  }
+  cache_policy = ops;
+  return 0;
+}
+
+const char *cache_policy_name(void)
+{
+  return cache_policy->name;
+}
+
+// 요청한 키에 해당하는 객체가 캐시에 있는지 탐색
+// 히트: 정책 갱신 + 참조 하나 획득 후 반환 (샤드 락은 이미 풀린 상태) → 사용이 끝나면 release_cache()
+// 미스: 시작할 때 연 스냅샷이나 디스크 계층에 있으면 메모리로 다시 올려 반환 (snapshot_load, disk_load), 없으면 NULL
+CachedObject *find_cache(char *path) 
+{
+  uint64_t hash = hash_key(path);
+  CacheShard *sp = shard_of(hash);
+  CachedObject *Cache;
 
-    if (prev_objtect)
-      Cache->prev->next = next_objtect;
-    Cache->next->prev = prev_objtect;
+  pthread_mutex_lock(&sp->lock);
+  if ((Cache = lookup(sp, path, hash)))
+  {
+    sp->policy.ops->access(&sp->policy, Cache);
+    __atomic_add_fetch(&Cache->refcnt, 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&sp->lock);
+  if (!Cache && (Cache = snapshot_load(path)))
+  {
+    Cache->refcnt = 1;  // 호출자의 참조
+    if (!write_cache_absent(Cache))
+    {
+      // 그사이 원 서버에서 받은 더 새로운 객체가 들어옴: 스냅샷 사본은 버리고 그것을 사용
+      release_cache(Cache);
+      return find_cache(path);
+    }
   }
-  else  // 현재 노드가 tail (마지막 노드)인 경우
+  if (!Cache && disk_enabled() && (Cache = disk_load(path)))
   {
-    Cache->prev->next = NULL;  // 이전 노드가 새 tail이 됨
-    lastp = Cache->prev;
+    Cache->refcnt = 1;  // 호출자의 참조
+    write_cache(Cache);
   }
+  return Cache;
+}
+
+// 이미 참조를 가진 객체에 참조 하나 추가 (다른 스레드에게 넘겨줄 때)
+void hold_cache(CachedObject *Cache)
+{
+  __atomic_add_fetch(&Cache->refcnt, 1, __ATOMIC_RELAXED);
+}
 
-  // 현재 노드를 리스트의 맨 앞으로 이동
-  Cache->next = rootp;
-  rootp->prev = Cache;
-  Cache->prev = NULL;
-  rootp = Cache;
+// 참조 반납. 마지막 참조였다면(이미 캐시에서 제거된 객체) 메모리 해제
+void release_cache(CachedObject *Cache)
+{
+  if (__atomic_sub_fetch(&Cache->refcnt, 1, __ATOMIC_ACQ_REL) == 0)
+    slab_free(Cache);  // 메타데이터, 키, 응답이 한 청크
 }
 
-// 새로운 캐시 객체를 연결 리스트에 추가
-void write_cache(CachedObject *Cache)
+// 클라이언트에게 캐시된 응답을 전송 (keep_alive면 Connection: keep-alive), 전송 실패 시 -1
+// 저장된 헤더 블록 + Age/Connection 줄 + 바디를 writev 한 번으로 보낸다 (헤더 블록과 바디는 복사하지 않음)
+int send_cache(CachedObject *Cache, int clientfd, int keep_alive)
 {
-  // 총 캐시 크기 갱신
-  total_cache_size += Cache->content_length;
+  outbuf_t ob;
+  int rc;
+
+  outbuf_init(&ob);
+  outbuf_append_ref(&ob, Cache->response_ptr, Cache->header_length);
+  outbuf_printf(&ob, "Age: %ld\r\nConnection: %s\r\n\r\n", cache_age(Cache), keep_alive ? "keep-alive" : "close");
+  outbuf_append_ref(&ob, Cache->response_ptr + Cache->header_length, Cache->content_length);
 
-  // 최대 캐시 크기 초과 시 가장 오래된 항목부터 제거
-  while (total_cache_size > MAX_CACHE_SIZE)
+  // 헤더 + 바디 전송 (클라이언트가 끊었으면 -1)
+  if ((rc = outbuf_write(&ob, clientfd, 0)) == 0)
+    cache_count(1, outbuf_size(&ob));
+  outbuf_free(&ob);
+  return rc;
+}
+
+// 클라이언트에게 응답 하나를 보냈음을 기록 (hit: 캐시에서, 아니면 원 서버에서 받아 전달)
+void cache_count(int hit, long bytes)
+{
+  __atomic_fetch_add(&stats.requests, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&stats.bytes, bytes, __ATOMIC_RELAXED);
+  if (hit)
   {
-    total_cache_size -= lastp->content_length;  // 캐시 크기 감소
+    __atomic_fetch_add(&stats.hits, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.hit_bytes, bytes, __ATOMIC_RELAXED);
+  }
+}
 
-    lastp = lastp->prev;        // 이전 노드를 새 tail로 설정
-    free(lastp->next);          // 이전 tail 메모리 해제
-    lastp->next = NULL;         // 새 tail의 next는 NULL
+// 누적 통계 스냅샷
+void cache_stats(cache_stats_t *st)
+{
+  st->requests = __atomic_load_n(&stats.requests, __ATOMIC_RELAXED);
+  st->hits = __atomic_load_n(&stats.hits, __ATOMIC_RELAXED);
+  st->bytes = __atomic_load_n(&stats.bytes, __ATOMIC_RELAXED);
+  st->hit_bytes = __atomic_load_n(&stats.hit_bytes, __ATOMIC_RELAXED);
+  st->stored = 0;
+  for (int i = 0; i < CACHE_SHARDS; i++)
+    st->stored += __atomic_load_n(&shards[i].total_cache_size, __ATOMIC_RELAXED);
+  st->mapped = slab_mapped();
+}
+
+// 새로운 캐시 객체를 해당 샤드의 정책 큐와 해시 테이블에 추가
+// 용량이 넘치면 정책이 고른 객체부터 제거한다 (정책에 따라 방금 넣은 객체가 바로 거절될 수도 있음)
+// 제거된 신선한 객체는 락을 푼 뒤 디스크 계층으로 내려보낸다
+// replace가 0이면 같은 키가 이미 있을 때 넣지 않고 0 반환 (객체는 그대로 호출자 소유)
+static int insert(CachedObject *Cache, int replace)
+{
+  CachedObject *old, *victim, *spill = NULL;
+  CacheShard *sp;
+
+  Cache->hash = hash_key(Cache->path);
+  sp = shard_of(Cache->hash);
+  pthread_mutex_lock(&sp->lock);
+
+  // 정책 큐에 추가. 같은 키가 이미 있으면 그 자리를 이어받고 옛 객체는 제거
+  old = lookup(sp, Cache->path, Cache->hash);
+  if (old && !replace)
+  {
+    pthread_mutex_unlock(&sp->lock);
+    return 0;
   }
+  __atomic_add_fetch(&Cache->refcnt, 1, __ATOMIC_RELAXED);  // 캐시가 보유하는 참조 (호출자가 미리 잡은 참조는 유지)
+  sp->policy.ops->insert(&sp->policy, Cache, old);
+  if (old)
+    evict(sp, old, NULL);
+
+  // 적재율 50% 초과 시 테이블 확장
+  if ((sp->table_count + 1) * 2 > sp->table_size)
+    table_grow(sp);
+
+  sp->table[probe(sp, Cache->path, Cache->hash)] = (HashSlot){Cache->hash, Cache};
+  sp->table_count++;
 
-  // 처음 캐시 추가인 경우 (rootp가 NULL)
-  if (!rootp)
-    lastp = Cache;
+  // 샤드 캐시 크기 갱신, 용량 초과 시 정책이 고른 객체부터 제거
+  sp->total_cache_size += Cache->reserved;
+  while (sp->total_cache_size > SHARD_CACHE_SIZE && (victim = sp->policy.ops->victim(&sp->policy)))
+    evict(sp, victim, &spill);
+  pthread_mutex_unlock(&sp->lock);
 
-  // 새 객체를 root로 삽입
-  if (rootp)
+  while ((victim = spill))
   {
-    Cache->next = rootp;
-    rootp->prev = Cache;
+    spill = victim->next;
+    disk_store(victim);
+    release_cache(victim);
   }
+  return 1;
+}
+
+void write_cache(CachedObject *Cache)
+{
+  insert(Cache, 1);
+}
 
-  Cache->prev = NULL;
-  rootp = Cache;
+// 같은 키가 없을 때만 저장하고 1, 이미 있으면(더 새로운 객체) 저장하지 않고 0 (스냅샷에서 되살린 객체용)
+int write_cache_absent(CachedObject *Cache)
+{
+  return insert(Cache, 0);
+}
+
+// 캐시에 있는 모든 객체를 참조를 하나씩 잡아 *out에 담고 개수 반환 (스냅샷 저장용, 사용 후 release_cache + free(*out))
+// 샤드마다 정책이 먼저 제거할 객체부터 담으므로, 이 순서대로 다시 넣으면 샤드별 정책 순서가 재현된다
+int cache_objects(CachedObject ***out)
+{
+  CachedObject **objs = NULL;
+  int n = 0, cap = 0;
+
+  for (int i = 0; i < CACHE_SHARDS; i++)
+  {
+    CacheShard *sp = &shards[i];
+
+    pthread_mutex_lock(&sp->lock);
+    if (n + (int)sp->table_count > cap)
+    {
+      cap = n + sp->table_count;
+      objs = Realloc(objs, cap * sizeof(CachedObject *));
+    }
+    for (int k = policy_order(&sp->policy, objs + n); k > 0; k--)
+      __atomic_add_fetch(&objs[n++]->refcnt, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&sp->lock);
+  }
+  *out = objs;
+  return n;
 }
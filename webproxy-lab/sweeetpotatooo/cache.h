@@ -1,25 +1,92 @@
 //webproxy-lab/sweeetpotatooo/cache.h
+#ifndef __CACHE_H__
+#define __CACHE_H__
 
 #include <stdio.h>
+#include <stdint.h>
 
 #include "csapp.h"
+#include "http.h"
 
+#define MAX_CACHE_SIZE 1049000
+#define MAX_OBJECT_SIZE 102400
+
+// 신선도 정보(Cache-Control max-age, Expires)가 없는 응답의 신선 수명
+#define CACHE_HEURISTIC_FRACTION 10 // Last-Modified가 있으면 (Date - Last-Modified) / 10
+#define CACHE_HEURISTIC_MAX 86400   // 휴리스틱 수명 상한 (초)
+#define CACHE_DEFAULT_TTL 60        // Last-Modified도 없으면 이 시간(초) 동안 신선
+
+// 캐시 샤드 수 (2의 거듭제곱). 샤드마다 락, 교체 정책 상태, 해시 테이블, 용량(MAX_CACHE_SIZE / CACHE_SHARDS)을 따로 가진다.
+// 용량은 슬랩에서 실제로 잡힌 바이트(메타데이터 + 키 + 헤더 블록 + 바디, 등급/페이지 반올림 포함)로 센다.
+// 샤드 하나의 용량이 가장 큰 객체(MAX_OBJECT_SIZE + 헤더 블록 최대 MAXBUF)의 청크 이상이어야 저장할 수 있다.
+#ifndef CACHE_SHARDS
+#define CACHE_SHARDS 8
+#endif
+
+// 캐시 객체는 원 서버 응답 전체를 그대로 보낼 수 있는 형태로 가진다.
+// response_ptr 한 덩어리 = 상태 줄 + end-to-end 헤더(header_length) + 바디(content_length).
+// Age, Connection 줄과 헤더 끝 빈 줄은 응답마다 달라서 보낼 때 붙인다 (send_cache).
+// 캐시 객체는 write_cache() 이후 불변이다 (prev/next는 샤드 락 아래에서, refreshing은 원자적으로만 바뀜).
+// refcnt: 캐시 자신이 1개, find_cache()/hold_cache()로 얻은 사용자마다 1개씩 보유하고, 0이 되는 순간 해제된다.
+// write_cache() 전에 refcnt를 1로 두면 저장 후에도 호출자가 참조 하나를 계속 가진다.
+// 따라서 전송 중인 객체가 제거(evict)되어도 마지막 사용자가 release_cache()할 때까지 메모리가 유지된다.
 typedef struct CachedObject
 {
-  char path[MAXLINE];                 // 요청 경로(URI) -> 캐시 키  
+  char *path;                         // 캐시 키 ("host:port/path", make_cache_key로 생성, 구조체 바로 뒤에 저장)
+  uint64_t hash;                      // 키의 64비트 해시 (샤드 선택 + 해시 테이블 인덱스)
+  char *response_ptr;                 // 헤더 블록 + 바디 (키 바로 뒤, 객체와 한 번에 할당)
+  int header_length;                  // 상태 줄 + 헤더 길이 (바디는 response_ptr + header_length부터)
   int content_length;                 // 응답 바디 길이
-  char *response_ptr;                 // 응답 바디 데이터
-  struct CachedObject *prev, *next;   // Doubly Linked List(LRU)
+  int status;                         // 응답 상태 코드
+  int reserved;                       // 슬랩에서 실제로 잡힌 바이트 (캐시 용량은 이 값으로 셈)
+  time_t stored_at;                   // 저장(또는 304로 재검증) 시각
+  long initial_age;                   // 저장 시점의 나이 (Age 헤더, Date 이후 흐른 시간 중 큰 값)
+  time_t expires;                     // 이 시각까지 신선, 이후에는 재검증 필요 (cache_is_fresh)
+  long stale_while_revalidate;        // 만료 후 이 시간(초) 동안은 사본으로 응답하며 백그라운드에서 갱신 (RFC 5861)
+  long stale_if_error;                // 만료 후 이 시간(초) 동안은 원 서버 5xx 대신 사본으로 응답
+  int refreshing;                     // 백그라운드 갱신 진행 중 (cache_begin_refresh로 한 작업만 잡음)
+  http_slice_t content_type;          // 아래 값들은 response_ptr 안을 가리킴 (헤더가 없으면 len 0)
+  http_slice_t etag, last_modified;   // 검증자
+  int refcnt;                         // 참조 수 (원자적으로 증감)
+  struct CachedObject *prev, *next;   // 교체 정책 큐의 양방향 연결 (policy.c)
+  unsigned char queue;                // 속한 정책 큐 번호
+  unsigned int freq;                  // 정책이 쓰는 접근 횟수 (S3-FIFO, GDSF)
+  int heap_pos;                       // GDSF 우선순위 힙 안의 위치
+  double priority;                    // GDSF 우선순위 (낮을수록 먼저 제거)
 } CachedObject;
 
+// 캐시가 응답한 요청(히트)과 원 서버에서 받아 전달한 GET 요청(미스)의 누적 통계 (/stats)
+// 바이트는 클라이언트에게 보낸 응답 크기 (헤더 블록 + 바디)
+typedef struct
+{
+  unsigned long requests, hits;
+  unsigned long bytes, hit_bytes;
+  unsigned long stored, mapped;  // 캐시가 차지한 슬랩 바이트, 슬랩이 OS에서 받은 바이트 (조회 시점 값)
+} cache_stats_t;
+
+void cache_init(void);
+int cache_set_policy(const char *name);
+const char *cache_policy_name(void);
+void make_cache_key(char *key, char *hostname, char *port, char *path);
+uint64_t cache_key_hash(const char *key);
+CachedObject *cache_object_alloc(const char *key, int header_length, int content_length);
+int cache_storable(char *data, int header_length);
+CachedObject *cache_object_new(char *key, char *data, int header_length, int content_length, long age);
+CachedObject *cache_object_refresh(CachedObject *old, char *hdrs, int hdrs_len, long age);
+int cache_is_fresh(CachedObject *Cache);
+long cache_age(CachedObject *Cache);
+int cache_within_swr(CachedObject *Cache);
+int cache_within_sie(CachedObject *Cache);
+int cache_begin_refresh(CachedObject *Cache);
+void cache_end_refresh(CachedObject *Cache);
 CachedObject *find_cache(char *path);
-void send_cache(CachedObject *Cache, int clientfd);
-void read_cache(CachedObject *Cache);
+void hold_cache(CachedObject *Cache);
+void release_cache(CachedObject *Cache);
+int send_cache(CachedObject *Cache, int clientfd, int keep_alive);
 void write_cache(CachedObject *Cache);
+int write_cache_absent(CachedObject *Cache);
+int cache_objects(CachedObject ***out);
+void cache_count(int hit, long bytes);
+void cache_stats(cache_stats_t *st);
 
-extern CachedObject *rootp;  // 캐시 연결리스트의 root 객체
-extern CachedObject *lastp;  // 캐시 연결리스트의 마지막 객체
-extern int total_cache_size; // 캐싱된 객체 크기의 총합
-
-#define MAX_CACHE_SIZE 1049000
-#define MAX_OBJECT_SIZE 102400
\ No newline at end of file
+#endif /* __CACHE_H__ */
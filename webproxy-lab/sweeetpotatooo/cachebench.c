@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "csapp.h"
+#include "cache.h"
+#include "slab.h"
+
+// 캐시 조회 마이크로벤치마크 (make cachebench)
+// 프록시와 같은 캐시 코드(cache.c)에 조회만 반복해 객체 수와 스레드 수에 따른 비용을 잰다.
+//
+// 사용법: ./cachebench lookup    객체 수(100 ~ 100000)별 find_cache 히트/미스 ns/op (스레드 하나)
+//         ./cachebench threads   스레드 1, 4, 16, 64개가 나눠 조회할 때 처리량(Mops/s)과 적중률
+//
+// lookup은 용량 한도에 걸리지 않도록 객체 크기를 1바이트로 세어 조회 비용만 남긴다.
+// threads는 실제 슬랩 크기로 세므로 키 공간 일부만 캐시에 남고, 미스마다 프록시처럼 새로 저장(제거 포함)한다.
+// 샤드 수에 따른 차이는 make clean && make cachebench CFLAGS="-g -Wall -O2 -DCACHE_SHARDS=1"처럼 다시 빌드해 비교한다.
+
+#define LOOKUPS 1000000     // lookup: 객체 수마다 조회 횟수
+#define THREAD_OPS 4000000  // threads: 스레드 수마다 전체 조회 횟수 (스레드끼리 나눔)
+#define THREAD_KEYS 4096    // threads: 키 공간
+#define THREAD_BODY 256     // threads: 객체 바디 크기 (키 공간 일부만 캐시에 들어감)
+
+// http.o가 참조하는 프록시 전역 (벤치마크는 요청을 만들지 않음)
+const char *user_agent_hdr = "";
+
+static char **keys;
+
+static double elapsed_ns(struct timespec *t0, struct timespec *t1)
+{
+  return (t1->tv_sec - t0->tv_sec) * 1e9 + (t1->tv_nsec - t0->tv_nsec);
+}
+
+// 스레드마다 따로 쓰는 xorshift 난수
+static unsigned next_rand(unsigned *s)
+{
+  *s ^= *s << 13;
+  *s ^= *s >> 17;
+  *s ^= *s << 5;
+  return *s;
+}
+
+static void make_keys(int n)
+{
+  char key[MAXLINE], path[MAXLINE];
+
+  keys = Malloc(n * sizeof(char *));
+  for (int i = 0; i < n; i++)
+  {
+    sprintf(path, "/static/assets/object-%d.js", i);
+    make_cache_key(key, "bench.example.com", "80", path);
+    keys[i] = strdup(key);
+  }
+}
+
+static void store(char *key, int reserved)
+{
+  CachedObject *Cache = cache_object_alloc(key, 0, 0);
+
+  Cache->reserved = reserved;
+  write_cache(Cache);
+}
+
+// 객체 n개를 넣고 무작위 키로 히트 조회, 없는 키로 미스 조회 비용을 잼
+static void bench_lookup(int n)
+{
+  struct timespec t0, t1, t2;
+  unsigned seed = 2463534242u;
+  char miss[MAXLINE];
+  long hits = 0;
+  CachedObject *Cache;
+
+  cache_set_policy("lru");  // 캐시를 비움
+  for (int i = 0; i < n; i++)
+    store(keys[i], 1);
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < LOOKUPS; i++)
+    if ((Cache = find_cache(keys[next_rand(&seed) % n])))
+    {
+      hits++;
+      release_cache(Cache);
+    }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  sprintf(miss, "%s-missing", keys[0]);
+  for (int i = 0; i < LOOKUPS; i++)
+    if ((Cache = find_cache(miss)))
+      release_cache(Cache);
+  clock_gettime(CLOCK_MONOTONIC, &t2);
+
+  printf("%8d %9.1f %9.1f %8.1f%%\n", n, elapsed_ns(&t0, &t1) / LOOKUPS, elapsed_ns(&t1, &t2) / LOOKUPS,
+         100.0 * hits / LOOKUPS);
+}
+
+typedef struct
+{
+  pthread_t tid;
+  long ops, hits;
+  unsigned seed;
+} worker_t;
+
+static void *worker(void *vargp)
+{
+  worker_t *w = vargp;
+  int reserved = slab_size(sizeof(CachedObject) + strlen(keys[0]) + 1 + THREAD_BODY);
+  CachedObject *Cache;
+
+  for (long i = 0; i < w->ops; i++)
+  {
+    // 앞쪽 키일수록 자주 (두 난수 중 작은 값)
+    unsigned a = next_rand(&w->seed) % THREAD_KEYS, b = next_rand(&w->seed) % THREAD_KEYS;
+    char *key = keys[a < b ? a : b];
+
+    if ((Cache = find_cache(key)))
+    {
+      w->hits++;
+      release_cache(Cache);
+    }
+    else
+      store(key, reserved);
+  }
+  return NULL;
+}
+
+static void bench_threads(int nthreads)
+{
+  worker_t *w = Calloc(nthreads, sizeof(worker_t));
+  struct timespec t0, t1;
+  long hits = 0;
+
+  cache_set_policy("lru");
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (int i = 0; i < nthreads; i++)
+  {
+    w[i].ops = THREAD_OPS / nthreads;
+    w[i].seed = 2463534242u + i * 7919;
+    Pthread_create(&w[i].tid, NULL, worker, &w[i]);
+  }
+  for (int i = 0; i < nthreads; i++)
+  {
+    Pthread_join(w[i].tid, NULL);
+    hits += w[i].hits;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  printf("%8d %9.2f %8.1f%%\n", nthreads, THREAD_OPS / elapsed_ns(&t0, &t1) * 1e3, 100.0 * hits / THREAD_OPS);
+  free(w);
+}
+
+int main(int argc, char **argv)
+{
+  static const int counts[] = {100, 1000, 10000, 100000};
+  static const int threads[] = {1, 4, 16, 64};
+
+  if (argc != 2 || (strcmp(argv[1], "lookup") && strcmp(argv[1], "threads")))
+    app_error("usage: cachebench lookup|threads");
+
+  cache_init();
+  if (!strcmp(argv[1], "lookup"))
+  {
+    make_keys(counts[3]);
+    printf("%8s %9s %9s %9s  (shards %d)\n", "entries", "hit ns", "miss ns", "hit", CACHE_SHARDS);
+    for (int i = 0; i < 4; i++)
+      bench_lookup(counts[i]);
+  }
+  else
+  {
+    make_keys(THREAD_KEYS);
+    printf("%8s %9s %9s  (shards %d)\n", "threads", "Mops/s", "hit", CACHE_SHARDS);
+    for (int i = 0; i < 4; i++)
+      bench_threads(threads[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "csapp.h"
+#include "cache.h"
+#include "policy.h"
+#include "slab.h"
+
+// 캐시 교체 정책 시뮬레이터
+// 접근 로그를 프록시와 같은 캐시 코드(cache.c, policy.c)에 그대로 재생해 정책별 적중률과 연산 비용을 비교한다.
+//
+// 사용법: ./cachesim [-p lru|tinylfu|s3fifo|gdsf] [-w gdsf크기가중치] [trace]
+//         (-p가 없으면 모든 정책, -w는 0..1로 기본 1, trace가 없으면 표준 입력)
+// trace 한 줄: <키> <바이트 수>   (예: "example.com:80/index.html 5120", #으로 시작하는 줄은 무시)
+//
+// 미스가 나면 프록시처럼 MAX_OBJECT_SIZE 이하인 객체만 저장한다.
+// 헤더 블록 없이 크기만 가진 객체를 만들므로 원 서버 응답 파싱/복사와 바디 할당 비용은 빠져 있다.
+// 용량은 프록시처럼 슬랩에서 잡힐 바이트(slab_size)로 세므로 크기 등급 반올림까지 반영된다.
+
+// http.o가 참조하는 프록시 전역 (시뮬레이터는 요청을 만들지 않음)
+const char *user_agent_hdr = "";
+
+typedef struct
+{
+  char *key;
+  long size;
+} access_t;
+
+static access_t *trace;
+static long ntrace;
+
+static void load_trace(FILE *fp)
+{
+  char line[MAXLINE], key[MAXLINE];
+  long cap = 0, size;
+
+  while (fgets(line, sizeof(line), fp))
+  {
+    if (line[0] == '#' || sscanf(line, "%s %ld", key, &size) != 2 || size < 0)
+      continue;
+    if (ntrace == cap)
+    {
+      cap = cap ? cap * 2 : 4096;
+      trace = Realloc(trace, cap * sizeof(access_t));
+    }
+    trace[ntrace].key = strdup(key);
+    trace[ntrace].size = size;
+    ntrace++;
+  }
+}
+
+// 로그 전체를 한 정책으로 재생하고 결과 한 줄 출력
+static void simulate(const char *policy)
+{
+  long hits = 0;
+  double bytes = 0, hit_bytes = 0;
+  struct timespec t0, t1;
+  CachedObject *Cache;
+
+  cache_set_policy(policy);  // 캐시를 비우고 정책 교체
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (long i = 0; i < ntrace; i++)
+  {
+    bytes += trace[i].size;
+    if ((Cache = find_cache(trace[i].key)))
+    {
+      hits++;
+      hit_bytes += trace[i].size;
+      release_cache(Cache);
+    }
+    else if (trace[i].size <= MAX_OBJECT_SIZE)
+    {
+      Cache = cache_object_alloc(trace[i].key, 0, 0);  // 키와 메타데이터만 실제로 할당
+      Cache->content_length = trace[i].size;
+      Cache->reserved = slab_size(sizeof(CachedObject) + strlen(trace[i].key) + 1 + trace[i].size);
+      write_cache(Cache);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  printf("%-8s %10ld %9.2f%% %9.2f%% %9.1f\n", policy, ntrace, ntrace ? 100.0 * hits / ntrace : 0.0,
+         bytes ? 100.0 * hit_bytes / bytes : 0.0,
+         ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / (ntrace ? ntrace : 1));
+}
+
+int main(int argc, char **argv)
+{
+  static const char *policies[] = {"lru", "tinylfu", "s3fifo", "gdsf"};
+  const char *only = NULL;
+  FILE *fp = stdin;
+  int i;
+
+  for (i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-p") && i + 1 < argc)
+      only = argv[++i];
+    else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+      policy_set_gdsf_weight(atof(argv[++i]));
+    else if (!(fp = fopen(argv[i], "r")))
+      unix_error("cachesim: trace open error");
+  }
+
+  cache_init();
+  if (only && cache_set_policy(only) < 0)
+    app_error("cachesim: unknown policy (lru|tinylfu|s3fifo|gdsf)");
+  load_trace(fp);
+
+  printf("%-8s %10s %10s %10s %9s\n", "policy", "requests", "hit", "byte_hit", "ns/op");
+  for (i = 0; i < 4; i++)
+    if (!only || !strcmp(only, policies[i]))
+      simulate(policies[i]);
+  return 0;
+}
@@ -0,0 +1,345 @@
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include "csapp.h"
+#include "disk.h"
+#include "outbuf.h"
+
+#define DISK_MAGIC 0x4b534944u   // "DISK"
+#define DISK_VERSION 1
+#define RECORD_MAGIC 0x21434552u // "REC!"
+
+// 흐름
+// disk_store(): 쓰기 위치를 락 안에서 예약(wpos 증가)하고, 락 밖에서 pwritev로 기록을 쓴 뒤 인덱스 슬롯을 갱신
+// 읽기: 락 안에서 슬롯을 찾아 위치를 얻고, 락 밖에서 pread, 읽은 뒤 그 위치가 아직 살아 있는지 다시 확인
+// 논리 위치 pos의 기록은 pos >= wpos - size 인 동안 살아 있다 (그보다 앞은 이미 덮어쓴 구간)
+// 쓰기 위치는 덮어쓰기 전에 먼저 늘리므로, 읽는 도중 덮였으면 다시 확인할 때 드러난다
+
+// 인덱스 파일 맨 앞 (mmap으로 바로 갱신되어 재시작 후에도 남음)
+typedef struct
+{
+  uint32_t magic, version;
+  uint64_t size;     // 로그 크기 (설정이 바뀌면 인덱스를 새로 만듦)
+  uint64_t nbuckets;
+  uint64_t wpos;     // 다음 기록의 논리 위치 (계속 증가, 로그 안 위치는 wpos % size)
+} disk_header_t;
+
+// 인덱스 슬롯 (hash 0은 빈 칸)
+typedef struct
+{
+  uint64_t hash;
+  uint64_t pos;      // 기록의 논리 위치
+  int64_t stored_at; // 같은 사본을 다시 쓰지 않도록 비교
+} disk_slot_t;
+
+// 로그 기록 헤더 (뒤에 키(NUL 포함), 헤더 블록, 바디)
+typedef struct
+{
+  uint32_t magic;
+  uint32_t key_len;
+  uint32_t header_length;
+  uint32_t content_length;
+  uint64_t hash;
+  int64_t stored_at, initial_age, expires;
+} disk_record_t;
+
+static int logfd = -1;
+static uint64_t log_size;
+static disk_header_t *hdr;
+static disk_slot_t *slots;
+static long max_object;
+static pthread_mutex_t disk_lock = PTHREAD_MUTEX_INITIALIZER; // 인덱스와 쓰기 위치 (로그 읽기/쓰기는 락 밖에서)
+static disk_stats_t stats;                                    // 원자적으로만 갱신
+
+// dir 아래 로그와 인덱스를 열고(없으면 만들고) 디스크 계층을 켬. 실패하면 -1
+// 로그 크기가 바뀌었거나 인덱스가 깨졌으면 비운 상태로 시작한다
+int disk_open(const char *dir, long size, long max_obj)
+{
+  char path[MAXLINE];
+  uint64_t nbuckets = size / DISK_BYTES_PER_SLOT / DISK_WAYS;
+  size_t idx_len = sizeof(disk_header_t) + nbuckets * DISK_WAYS * sizeof(disk_slot_t);
+  int idxfd;
+  void *p;
+
+  if (max_obj < MAX_OBJECT_SIZE)
+    max_obj = MAX_OBJECT_SIZE;
+  // 기록 하나가 로그의 1/4을 넘지 않아야 전송 중인 기록이 바로 덮이지 않음 (disk_send)
+  if (!nbuckets || (max_obj + MAXBUF + MAXLINE + (long)sizeof(disk_record_t)) * 4 > size)
+    return -1;
+
+  mkdir(dir, 0755); // 이미 있으면 실패해도 그대로 사용
+  snprintf(path, sizeof(path), "%s/cache.log", dir);
+  if ((logfd = open(path, O_RDWR | O_CREAT, 0644)) < 0)
+    return -1;
+  snprintf(path, sizeof(path), "%s/cache.idx", dir);
+  if ((idxfd = open(path, O_RDWR | O_CREAT, 0644)) < 0)
+  {
+    close(logfd);
+    logfd = -1;
+    return -1;
+  }
+  if (ftruncate(logfd, size) < 0 || ftruncate(idxfd, idx_len) < 0 ||
+      (p = mmap(NULL, idx_len, PROT_READ | PROT_WRITE, MAP_SHARED, idxfd, 0)) == MAP_FAILED)
+  {
+    close(idxfd);
+    close(logfd);
+    logfd = -1;
+    return -1;
+  }
+  close(idxfd);
+
+  hdr = p;
+  slots = (disk_slot_t *)(hdr + 1);
+  if (hdr->magic != DISK_MAGIC || hdr->version != DISK_VERSION || hdr->size != (uint64_t)size || hdr->nbuckets != nbuckets)
+  {
+    memset(p, 0, idx_len);
+    hdr->magic = DISK_MAGIC;
+    hdr->version = DISK_VERSION;
+    hdr->size = size;
+    hdr->nbuckets = nbuckets;
+  }
+  log_size = size;
+  max_object = max_obj;
+  return 0;
+}
+
+int disk_enabled(void)
+{
+  return logfd >= 0;
+}
+
+// 디스크에 둘 수 있는 최대 바디 크기 (MAX_OBJECT_SIZE 이상)
+long disk_max_object(void)
+{
+  return max_object;
+}
+
+// 논리 위치 pos의 기록이 아직 덮이지 않았으면 1 (disk_lock 안에서)
+static int live(uint64_t pos)
+{
+  return pos + log_size >= hdr->wpos;
+}
+
+static int still_live(uint64_t pos)
+{
+  int r;
+
+  pthread_mutex_lock(&disk_lock);
+  r = live(pos);
+  pthread_mutex_unlock(&disk_lock);
+  return r;
+}
+
+// 키 해시 (0은 빈 칸 표시라 최하위 비트를 켬)
+static uint64_t disk_hash(const char *key)
+{
+  return cache_key_hash(key) | 1;
+}
+
+// hash의 살아 있는 슬롯 (disk_lock 안에서), 없으면 NULL
+static disk_slot_t *find_slot(uint64_t hash)
+{
+  disk_slot_t *b = slots + (hash % hdr->nbuckets) * DISK_WAYS;
+
+  for (int i = 0; i < DISK_WAYS; i++)
+    if (b[i].hash == hash && live(b[i].pos))
+      return &b[i];
+  return NULL;
+}
+
+static int pread_full(void *buf, size_t n, off_t off)
+{
+  ssize_t r;
+
+  while (n > 0)
+  {
+    if ((r = pread(logfd, buf, n, off)) < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      return -1;
+    buf = (char *)buf + r;
+    n -= r;
+    off += r;
+  }
+  return 0;
+}
+
+// 메모리에서 내려온 객체(또는 메모리에 못 들어가는 큰 객체)를 로그 끝에 기록하고 인덱스에 등록
+// 같은 사본(stored_at이 같은 기록)이 아직 살아 있으면 다시 쓰지 않는다
+void disk_store(CachedObject *Cache)
+{
+  disk_record_t rec;
+  disk_slot_t *s, *b;
+  uint64_t hash, pos;
+  uint32_t key_len, len;
+  struct iovec iov[3];
+
+  if (logfd < 0 || Cache->content_length > max_object)
+    return;
+  hash = disk_hash(Cache->path);
+  key_len = strlen(Cache->path) + 1;
+  len = (sizeof(rec) + key_len + Cache->header_length + Cache->content_length + 7) & ~7u;
+
+  // 쓰기 위치 예약 (로그 끝에 다 들어가지 않으면 처음부터)
+  pthread_mutex_lock(&disk_lock);
+  if ((s = find_slot(hash)) && s->stored_at == Cache->stored_at)
+  {
+    pthread_mutex_unlock(&disk_lock);
+    return;
+  }
+  pos = hdr->wpos;
+  if (pos % log_size + len > log_size)
+    pos += log_size - pos % log_size;
+  hdr->wpos = pos + len;
+  pthread_mutex_unlock(&disk_lock);
+
+  rec.magic = RECORD_MAGIC;
+  rec.key_len = key_len;
+  rec.header_length = Cache->header_length;
+  rec.content_length = Cache->content_length;
+  rec.hash = hash;
+  rec.stored_at = Cache->stored_at;
+  rec.initial_age = Cache->initial_age;
+  rec.expires = Cache->expires;
+  iov[0] = (struct iovec){&rec, sizeof(rec)};
+  iov[1] = (struct iovec){Cache->path, key_len};
+  iov[2] = (struct iovec){Cache->response_ptr, (size_t)Cache->header_length + Cache->content_length};
+  if (pwritev(logfd, iov, 3, pos % log_size) != (ssize_t)(sizeof(rec) + key_len + iov[2].iov_len))
+    return; // 인덱스에 올리지 않으면 없는 기록
+
+  // 같은 키의 슬롯, 빈(또는 덮인) 슬롯, 가장 오래된 슬롯 순으로 자리를 고름
+  pthread_mutex_lock(&disk_lock);
+  if (live(pos))
+  {
+    if (!(s = find_slot(hash)))
+    {
+      b = slots + (hash % hdr->nbuckets) * DISK_WAYS;
+      s = &b[0];
+      for (int i = 0; i < DISK_WAYS; i++)
+      {
+        if (!b[i].hash || !live(b[i].pos))
+        {
+          s = &b[i];
+          break;
+        }
+        if (b[i].pos < s->pos)
+          s = &b[i];
+      }
+    }
+    *s = (disk_slot_t){hash, pos, Cache->stored_at};
+  }
+  pthread_mutex_unlock(&disk_lock);
+  __atomic_fetch_add(&stats.writes, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&stats.write_bytes, len, __ATOMIC_RELAXED);
+}
+
+// key의 기록 헤더를 읽고 키를 확인. 있으면 0과 *pos에 논리 위치
+static int lookup(char *key, disk_record_t *rec, uint64_t *pos)
+{
+  uint64_t hash = disk_hash(key);
+  disk_slot_t *s;
+  char k[MAXLINE];
+
+  pthread_mutex_lock(&disk_lock);
+  if ((s = find_slot(hash)))
+    *pos = s->pos;
+  pthread_mutex_unlock(&disk_lock);
+  if (!s)
+    return -1;
+
+  if (pread_full(rec, sizeof(*rec), *pos % log_size) < 0 || rec->magic != RECORD_MAGIC || rec->hash != hash ||
+      !rec->key_len || rec->key_len > MAXLINE || pread_full(k, rec->key_len, *pos % log_size + sizeof(*rec)) < 0 ||
+      k[rec->key_len - 1] || strcmp(k, key))
+    return -1;
+  return 0;
+}
+
+// 메모리 캐시 미스 때 디스크에 있는 작은 객체(MAX_OBJECT_SIZE 이하)를 읽어 캐시 객체로 만듦 (refcnt 0, 없으면 NULL)
+// 나이 기준(stored_at, initial_age)은 디스크 사본 그대로 두어 다시 내려갈 때 같은 사본을 또 쓰지 않는다
+CachedObject *disk_load(char *key)
+{
+  disk_record_t rec;
+  uint64_t pos;
+  CachedObject *Cache = NULL;
+  char *data;
+  long len;
+
+  if (logfd < 0 || lookup(key, &rec, &pos) < 0 || rec.content_length > MAX_OBJECT_SIZE)
+    return NULL;
+
+  len = (long)rec.header_length + rec.content_length;
+  data = Malloc(len + 1);
+  if (pread_full(data, len, pos % log_size + sizeof(rec) + rec.key_len) == 0 && still_live(pos) &&
+      (Cache = cache_object_new(key, data, rec.header_length, rec.content_length,
+                                rec.initial_age + (time(NULL) - rec.stored_at))))
+  {
+    Cache->stored_at = rec.stored_at;
+    Cache->initial_age = rec.initial_age;
+    Cache->expires = rec.expires;
+    __atomic_fetch_add(&stats.hits, 1, __ATOMIC_RELAXED);
+  }
+  free(data);
+  return Cache;
+}
+
+// 디스크에 있는 큰 객체(MAX_OBJECT_SIZE 초과)를 신선하면 바로 전송: 헤더 블록을 읽어 보내고, 바디는 DISK_SEND_CHUNK씩 읽어 보냄
+// 조각마다 읽은 뒤 그 위치가 아직 살아 있는지 확인하고 나서 보내므로, 전송이 느려 로그가 한 바퀴 돌아 덮이면
+// 덮인 바이트를 보내기 전에 바디 도중에 멈춘다 (클라이언트는 Content-Length보다 짧은 응답과 연결 종료로 알 수 있음)
+// sendfile은 보낸 뒤에도 소켓 버퍼가 페이지 캐시를 가리켜 덮어쓰기가 섞일 수 있어 쓰지 않는다
+// 없거나 만료됐거나 곧 덮일 위치(로그의 가장 오래된 1/4)면 -1 (호출자가 원 서버로),
+// 보냈으면 1, 전송에 실패했거나 보내는 도중 덮였으면 0 (클라이언트 연결을 닫아야 함)
+int disk_send(char *key, int clientfd, int keep_alive)
+{
+  disk_record_t rec;
+  uint64_t pos;
+  outbuf_t ob;
+  char *hdrs, *chunk;
+  off_t off;
+  long left, n;
+  int ok;
+
+  if (logfd < 0 || lookup(key, &rec, &pos) < 0 || rec.content_length <= MAX_OBJECT_SIZE || time(NULL) >= rec.expires)
+    return -1;
+  pthread_mutex_lock(&disk_lock);
+  ok = pos + log_size - log_size / 4 >= hdr->wpos;
+  pthread_mutex_unlock(&disk_lock);
+  if (!ok)
+    return -1;
+
+  hdrs = Malloc(rec.header_length);
+  off = pos % log_size + sizeof(rec) + rec.key_len;
+  if (pread_full(hdrs, rec.header_length, off) < 0 || !still_live(pos))
+  {
+    free(hdrs);
+    return -1;
+  }
+
+  // 헤더는 MSG_MORE로 보내 바디 첫 조각과 같은 세그먼트에 싣는다
+  outbuf_init(&ob);
+  outbuf_append_ref(&ob, hdrs, rec.header_length);
+  outbuf_printf(&ob, "Age: %ld\r\nConnection: %s\r\n\r\n", (long)(rec.initial_age + (time(NULL) - rec.stored_at)),
+                keep_alive ? "keep-alive" : "close");
+  ok = outbuf_write(&ob, clientfd, 1) == 0;
+  off += rec.header_length;
+  chunk = Malloc(DISK_SEND_CHUNK);
+  for (left = rec.content_length; ok && left > 0; left -= n, off += n)
+  {
+    n = left < DISK_SEND_CHUNK ? left : DISK_SEND_CHUNK;
+    ok = pread_full(chunk, n, off) == 0 && still_live(pos) && rio_writen(clientfd, chunk, n) == n;
+  }
+  if (ok)
+  {
+    cache_count(1, outbuf_size(&ob) + rec.content_length);
+    __atomic_fetch_add(&stats.hits, 1, __ATOMIC_RELAXED);
+  }
+  outbuf_free(&ob);
+  free(chunk);
+  free(hdrs);
+  return ok;
+}
+
+void disk_stats(disk_stats_t *st)
+{
+  st->hits = __atomic_load_n(&stats.hits, __ATOMIC_RELAXED);
+  st->writes = __atomic_load_n(&stats.writes, __ATOMIC_RELAXED);
+  st->write_bytes = __atomic_load_n(&stats.write_bytes, __ATOMIC_RELAXED);
+}
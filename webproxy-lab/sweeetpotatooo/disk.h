@@ -0,0 +1,34 @@
+//webproxy-lab/sweeetpotatooo/disk.h
+#ifndef __DISK_H__
+#define __DISK_H__
+
+#include <stdint.h>
+
+#include "csapp.h"
+#include "cache.h"
+
+#define DISK_DEFAULT_SIZE_MB 64        // 로그 파일 기본 크기
+#define DISK_DEFAULT_MAX_OBJECT_KB 4096 // 메모리에 못 들어가는 큰 객체 중 디스크에 둘 최대 바디 크기 기본값
+#define DISK_WAYS 4                    // 인덱스 버킷 하나의 슬롯 수 (가득 차면 가장 오래된 기록을 밀어냄)
+#define DISK_BYTES_PER_SLOT 2048       // 인덱스 슬롯 수 = 로그 크기 / 이 값
+#define DISK_SEND_CHUNK (64 * 1024)    // 큰 객체를 보낼 때 한 번에 읽어 보내는 크기 (조각마다 덮이지 않았는지 확인)
+
+// 메모리 캐시 아래의 디스크 계층 (--disk-cache=DIR로 켬)
+// DIR/cache.log: 고정 크기 원형 로그. 기록은 [헤더][키][헤더 블록][바디]로 끝에만 덧붙이고, 가득 차면 처음부터 덮어쓴다.
+// DIR/cache.idx: mmap한 해시 인덱스 (키 해시 → 로그 위치). 로그 쓰기 위치도 여기 있어 재시작하면 그대로 이어 쓴다.
+// 메모리에서 제거된 신선한 객체와 MAX_OBJECT_SIZE보다 큰 객체가 내려오고,
+// 작은 객체는 find_cache 미스 때 메모리로 다시 올리고(disk_load), 큰 객체는 조각씩 읽어 바로 보낸다(disk_send).
+typedef struct
+{
+  unsigned long hits, writes, write_bytes;
+} disk_stats_t;
+
+int disk_open(const char *dir, long size, long max_object);
+int disk_enabled(void);
+long disk_max_object(void);
+void disk_store(CachedObject *Cache);
+CachedObject *disk_load(char *key);
+int disk_send(char *key, int clientfd, int keep_alive);
+void disk_stats(disk_stats_t *st);
+
+#endif /* __DISK_H__ */
@@ -0,0 +1,630 @@
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#include "csapp.h"
+#include "cache.h"
+#include "refresh.h"
+#include "proxy.h"
+#include "event.h"
+#include "resolver.h"
+#include "http.h"
+
+#define EV_MAX_EVENTS 256          // epoll_wait 한 번에 받을 최대 이벤트 수
+#define EV_REQ_INITSIZE 1024       // 요청 버퍼 초기 크기 (첫 데이터가 도착해야 할당)
+#define EV_MAX_REQUEST (4 * MAXBUF) // 요청 헤더 최대 크기
+#define EV_RELAY_BUFSIZE 16384     // 응답 중계 버퍼 크기
+
+// 연결 상태: 요청 읽기 → 파싱/캐시 조회 → 서버 연결 → 요청 전송 → 응답 중계 → 종료
+typedef enum
+{
+  ST_READ_REQUEST, // 클라이언트 요청 헤더 수신 중
+  ST_CONNECT,      // 원 서버에 논블로킹 connect 진행 중
+  ST_SEND_REQUEST, // 재작성한 요청을 서버로 전송 중
+  ST_RELAY,        // 서버 응답을 클라이언트로 중계 중
+  ST_WRITE_CLIENT  // 캐시/에러 응답을 클라이언트로 전송 중 (다 보내면 종료)
+} conn_state;
+
+typedef struct conn conn_t;
+
+// epoll에 등록되는 소켓 한쪽 끝 (epoll_event.data.ptr로 전달)
+typedef struct
+{
+  conn_t *conn;
+  int fd;
+  unsigned events; // 현재 관심 이벤트 (0이면 epoll에서 제거된 상태)
+} endpoint_t;
+
+// 연결 하나의 상태. 유휴 연결은 이 구조체만 차지하고 버퍼는 필요할 때 할당한다.
+struct conn
+{
+  conn_state state;
+  endpoint_t client, server;
+  char *req;              // 클라이언트 요청 수신 버퍼
+  size_t req_len, req_cap;
+  char *buf;              // 송신 버퍼 (서버로 보낼 요청, 클라이언트로 보낼 응답)
+  size_t len, off, cap;   // 유효 길이, 전송 시작 위치, 용량
+  char *key;              // 캐시 키 (make_cache_key)
+  char *resp;             // 캐시 저장용 응답 사본 (MAX_OBJECT_SIZE 이하일 때만 유지)
+  size_t resp_len;
+  size_t relayed;         // 클라이언트로 중계한 응답 바이트 (캐시 미스 통계)
+  CachedObject *hit;      // 캐시 히트 객체 (참조 보유, 바디를 복사 없이 직접 전송)
+  size_t hit_off;         // hit 바디 전송 위치
+  CachedObject *stale;    // 만료된 사본 (참조 보유, 원 서버에 연결하지 못하면 대신 응답)
+};
+
+static __thread int loop_epfd; // 현재 스레드의 epoll 인스턴스
+
+// 엔드포인트의 관심 이벤트를 변경. 0이면 epoll에서 빼서 HUP/ERR도 받지 않게 한다.
+static void ev_set(endpoint_t *ep, unsigned events)
+{
+  struct epoll_event ev;
+
+  if (ep->events == events)
+    return;
+
+  ev.events = events;
+  ev.data.ptr = ep;
+  if (!events)
+    epoll_ctl(loop_epfd, EPOLL_CTL_DEL, ep->fd, NULL);
+  else if (!ep->events)
+    epoll_ctl(loop_epfd, EPOLL_CTL_ADD, ep->fd, &ev);
+  else
+    epoll_ctl(loop_epfd, EPOLL_CTL_MOD, ep->fd, &ev);
+  ep->events = events;
+}
+
+// 연결 종료: 소켓을 닫으면 epoll 등록도 함께 해제된다
+static void conn_close(conn_t *c)
+{
+  Close(c->client.fd);
+  if (c->server.fd >= 0)
+    Close(c->server.fd);
+  free(c->req);
+  free(c->buf);
+  free(c->key);
+  free(c->resp);
+  if (c->hit)
+    release_cache(c->hit);
+  if (c->stale)
+    release_cache(c->stale);
+  free(c);
+}
+
+// 송신 버퍼 뒤에 n바이트 추가 (필요하면 두 배씩 확장)
+// 송신 버퍼 끝에 n바이트 이상 자리를 만들고 그 위치 반환 (쓴 만큼 c->len을 늘려 확정)
+static char *buf_reserve(conn_t *c, size_t n)
+{
+  if (c->len + n > c->cap)
+  {
+    size_t cap = c->cap ? c->cap : EV_REQ_INITSIZE;
+    while (cap < c->len + n)
+      cap *= 2;
+    c->buf = Realloc(c->buf, cap);
+    c->cap = cap;
+  }
+  return c->buf + c->len;
+}
+
+static void buf_append(conn_t *c, const char *data, size_t n)
+{
+  memcpy(buf_reserve(c, n), data, n);
+  c->len += n;
+}
+
+// 에러 응답을 송신 버퍼에 넣고 클라이언트 쓰기 상태로 전환
+static void queue_error(conn_t *c, char *cause, char *errnum, char *shortmsg, char *longmsg)
+{
+  char msg[CLIENTERROR_BUFSIZE];
+  int n = format_clienterror(msg, cause, errnum, shortmsg, longmsg);
+
+  c->len = c->off = 0;
+  buf_append(c, msg, n);
+  c->state = ST_WRITE_CLIENT;
+  if (c->server.fd >= 0)
+  {
+    ev_set(&c->server, 0);
+    Close(c->server.fd);
+    c->server.fd = -1;
+  }
+  ev_set(&c->client, EPOLLOUT);
+}
+
+// 캐시 객체로 응답: 저장된 헤더 블록 + Age/Connection 줄을 송신 버퍼에 넣고, 바디는 참조를 들고 직접 전송
+// cached_object의 참조는 연결이 넘겨받는다 (연결 종료 시 반납)
+static void queue_hit(conn_t *c, CachedObject *cached_object)
+{
+  char tail[64];
+  int n;
+
+  c->len = c->off = 0;
+  buf_append(c, cached_object->response_ptr, cached_object->header_length);
+  n = snprintf(tail, sizeof(tail), "Age: %ld\r\nConnection: close\r\n\r\n", cache_age(cached_object));
+  buf_append(c, tail, n);
+  cache_count(1, c->len + cached_object->content_length);
+  c->hit = cached_object;
+  c->hit_off = 0;
+
+  c->state = ST_WRITE_CLIENT;
+  ev_set(&c->client, EPOLLOUT);
+}
+
+// 캐시 히트면 응답을 준비하고 1
+// stale-while-revalidate 기간 안의 만료된 사본은 바로 응답하고 갱신은 백그라운드 작업에 맡긴다
+// 그 밖의 만료된 사본은 쓰지 않고 원 서버에서 새로 받는다 (이 엔진은 조건부 재검증을 하지 않음)
+// 대신 참조를 c->stale에 남겨 원 서버에 연결하지 못했을 때 응답한다 (RFC 9111 4.2.4)
+static int queue_cached(conn_t *c, char *hostname, char *port, char *path)
+{
+  // 히트면 정책 갱신 후 참조를 하나 얻음
+  CachedObject *cached_object = find_cache(c->key);
+  if (!cached_object)
+    return 0;
+  if (!cache_is_fresh(cached_object) &&
+      !(cache_within_swr(cached_object) && refresh_submit(cached_object, hostname, port, path) == 0))
+  {
+    c->stale = cached_object;
+    return 0;
+  }
+  queue_hit(c, cached_object);
+  return 1;
+}
+
+// 원 서버 연결 실패(또는 stale-if-error 기간 안의 5xx): 만료된 사본이 있으면 그것으로, 없으면 502로 응답
+static void origin_failed(conn_t *c, char *cause)
+{
+  if (!c->stale)
+  {
+    queue_error(c, cause, "502", "Bad Gateway", "Failed to establish connection with the end server");
+    return;
+  }
+  if (c->server.fd >= 0)
+  {
+    ev_set(&c->server, 0);
+    Close(c->server.fd);
+    c->server.fd = -1;
+  }
+  queue_hit(c, c->stale);
+  c->stale = NULL;
+}
+
+// 응답 사본을 스레드 엔진과 같은 조건(GET, 바디 <= MAX_OBJECT_SIZE, cache_object_new의 캐싱 규칙)으로 캐시에 저장
+// 헤더 블록은 hop-by-hop 헤더와 Age를 뺀 end-to-end 헤더만 남기고, 바디와 한 덩어리로 붙인다
+static void store_response(conn_t *c)
+{
+  char *hdr_end, *line, *eol, *data;
+  int hdr_len;
+  long content_length = -1, body_len, age = 0;
+  CachedObject *cached_object;
+  http_header_t h;
+
+  if (!c->resp || !c->key)
+    return;
+  c->resp[c->resp_len] = '\0';
+  if (!(hdr_end = strstr(c->resp, "\r\n\r\n")) || strncmp(c->resp, "HTTP/", 5))
+    return;
+  hdr_end += 2;  // 마지막 헤더 줄의 끝
+  body_len = c->resp_len - (hdr_end + 2 - c->resp);
+
+  // 헤더 블록 + 바디 (Content-length 줄을 붙일 여유 포함)
+  data = Malloc((hdr_end - c->resp) + 32 + body_len);
+  eol = memchr(c->resp, '\n', hdr_end - c->resp);
+  hdr_len = eol + 1 - c->resp;
+  memcpy(data, c->resp, hdr_len);  // 상태 줄
+
+  for (line = eol + 1; line < hdr_end; line = eol + 1)
+  {
+    eol = memchr(line, '\n', hdr_end - line);
+    if (http_parse_header(line, eol + 1 - line, &h) < 0 || h.id == HDR_TRANSFER_ENCODING)
+    {
+      free(data);
+      return;
+    }
+    if (h.id == HDR_CONTENT_LENGTH)
+      content_length = atol(h.value.p);
+    if (h.id == HDR_AGE)
+    {
+      age = atol(h.value.p);  // 저장 시점의 나이로만 쓰고, 응답할 때 새로 계산해 붙임
+      continue;
+    }
+    if (h.id == HDR_CONNECTION || h.id == HDR_KEEP_ALIVE || h.id == HDR_PROXY_CONNECTION)
+      continue;
+    memcpy(data + hdr_len, line, eol + 1 - line);
+    hdr_len += eol + 1 - line;
+  }
+
+  // 서버가 닫을 때까지 읽었으므로 Content-length가 없으면 받은 만큼이 바디
+  if (content_length < 0)
+    hdr_len += sprintf(data + hdr_len, "Content-length: %ld\r\n", body_len);
+  else if (content_length <= body_len)
+    body_len = content_length;
+  else
+    body_len = -1;  // 덜 받은 응답
+  if (body_len < 0 || body_len > MAX_OBJECT_SIZE)
+  {
+    free(data);
+    return;
+  }
+  memcpy(data + hdr_len, hdr_end + 2, body_len);
+
+  // 같은 키가 이미 있으면 write_cache()가 교체하므로 중복 저장되지 않음
+  if ((cached_object = cache_object_new(c->key, data, hdr_len, body_len, age)))
+    write_cache(cached_object);
+  free(data);  // 캐시는 슬랩에 복사본을 가짐
+}
+
+// 원 서버로 논블로킹 connect 시작. 성공적으로 시작했으면 소켓, 실패하면 -1
+static int start_connect(char *hostname, char *port)
+{
+  resolved_addr_t addrs[RESOLVER_MAX_ADDRS];
+  int n, fd;
+
+  // 주소는 DNS 캐시에서 (미스일 때만 getaddrinfo로 루프가 잠깐 멈춤)
+  if ((n = resolver_lookup(hostname, port, addrs, RESOLVER_MAX_ADDRS)) < 0)
+    return -1;
+
+  for (int i = 0; i < n; i++)
+  {
+    if ((fd = socket(addrs[i].family, addrs[i].socktype | SOCK_NONBLOCK, addrs[i].protocol)) < 0)
+      continue;
+    if (connect(fd, (struct sockaddr *)&addrs[i].addr, addrs[i].addrlen) == 0 || errno == EINPROGRESS)
+      return fd;
+    close(fd);
+  }
+  return -1;
+}
+
+// 요청 헤더가 모두 도착한 뒤: 파싱 → 캐시 조회 → 요청 재작성 → 서버 연결 시작
+static void process_request(conn_t *c)
+{
+  char *method, *uri, *version;
+  char hostname[MAXLINE] = "", port[MAXLINE] = "", path[MAXLINE] = "";
+  char key[MAXLINE];
+  char *p, *eol;
+  http_rewrite_t rw;
+  http_header_t h;
+  int n, rc;
+  int ua_len = strlen(user_agent_hdr); // 다시 쓴 줄은 원래 줄보다 최대 이만큼 길어짐 (User-Agent 교체)
+
+  // 요청 라인: method, uri 추출(c->req 안에서 제자리 분리) → uri 파싱
+  eol = strstr(c->req, "\r\n");
+  *eol = '\0';
+  if (eol - c->req >= MAXLINE || http_parse_request_line(c->req, &method, &uri, &version) < 0)
+  {
+    queue_error(c, "request", "400", "Bad Request", "Proxy could not parse the request");
+    return;
+  }
+  parse_uri(uri, hostname, port, path);
+  if (strlen(hostname) > MAX_HOSTNAME || strlen(port) > MAX_PORT)
+  {
+    queue_error(c, "host", "400", "Bad Request", "Host name or port too long");
+    return;
+  }
+
+  // 지원하지 않는 method 예외 처리
+  if (strcasecmp(method, "GET") && strcasecmp(method, "HEAD"))
+  {
+    queue_error(c, method, "501", "Not implemented", "Tiny does not implement this method");
+    return;
+  }
+
+  // 캐시 확인 (캐시는 바디를 함께 보내므로 GET만, key가 있는 연결만 응답을 저장)
+  if (!strcasecmp(method, "GET"))
+  {
+    make_cache_key(key, hostname, port, path);
+    c->key = strdup(key);
+    if (queue_cached(c, hostname, port, path))
+      return;
+  }
+
+  // 첫 줄 재구성 + 헤더 재작성 (스레드 엔진과 같은 http_rewrite_* 사용)
+  // 송신 버퍼에 바로 쓰고, 줄마다 다시 쓴 결과가 들어갈 만큼 자리를 먼저 확보한다
+  c->len = c->off = 0;
+  n = strlen(method) + strlen(path) + 16;
+  c->len += snprintf(buf_reserve(c, n), n, "%s %s HTTP/1.0\r\n", method, path);
+  http_rewrite_init(&rw, 0);
+  for (p = eol + 2;; p = eol + 2)
+  {
+    eol = strstr(p, "\r\n");
+    if ((rc = http_parse_header(p, eol - p + 2, &h)) == 0)
+      break;
+    if (rc < 0 || eol - p + 2 >= MAXLINE)
+    {
+      queue_error(c, "header", "400", "Bad Request", "Malformed or too long request header line");
+      return;
+    }
+    c->len += http_rewrite_header(&rw, &h, p, eol - p + 2, buf_reserve(c, eol - p + 2 + ua_len), 0);
+  }
+  n = strlen(hostname) + strlen(port) + ua_len + 64;
+  c->len += http_rewrite_finish(&rw, buf_reserve(c, n), 0, hostname, port);
+  free(c->req);
+  c->req = NULL;
+
+  // 서버 연결 시작: 연결이 끝나면 EPOLLOUT으로 알림
+  if ((c->server.fd = start_connect(hostname, port)) < 0)
+  {
+    origin_failed(c, hostname);
+    return;
+  }
+  c->state = ST_CONNECT;
+  ev_set(&c->client, 0);
+  ev_set(&c->server, EPOLLOUT);
+}
+
+// 클라이언트 요청 수신. 헤더 끝(빈 줄)까지 모이면 process_request()로 넘김
+static int read_request(conn_t *c)
+{
+  ssize_t n;
+  size_t scan_from;
+
+  while (1)
+  {
+    if (c->req_len + 1 >= c->req_cap)
+    {
+      if (c->req_cap >= EV_MAX_REQUEST)
+        return -1;
+      c->req_cap = c->req_cap ? c->req_cap * 2 : EV_REQ_INITSIZE;
+      c->req = Realloc(c->req, c->req_cap);
+    }
+    n = read(c->client.fd, c->req + c->req_len, c->req_cap - c->req_len - 1);
+    if (n == 0)
+      return -1;
+    if (n < 0)
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+    // 이미 검사한 부분은 건너뛰고 새로 들어온 데이터 근처만 빈 줄 검색
+    scan_from = c->req_len > 3 ? c->req_len - 3 : 0;
+    c->req_len += n;
+    c->req[c->req_len] = '\0';
+    if (strstr(c->req + scan_from, "\r\n\r\n"))
+    {
+      process_request(c);
+      return 0;
+    }
+  }
+}
+
+// 송신 버퍼를 fd로 최대한 전송. 모두 보냈으면 1, 더 기다려야 하면 0, 에러면 -1
+static int flush_buf(conn_t *c, int fd)
+{
+  ssize_t n;
+
+  while (c->off < c->len)
+  {
+    if ((n = write(fd, c->buf + c->off, c->len - c->off)) < 0)
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    c->off += n;
+  }
+  c->len = c->off = 0;
+  return 1;
+}
+
+// 캐시/에러 응답 전송: 헤더(송신 버퍼) → 캐시 바디 순서. 모두 보냈으면 1
+static int write_client(conn_t *c)
+{
+  ssize_t n;
+  int rc;
+
+  if ((rc = flush_buf(c, c->client.fd)) <= 0)
+    return rc;
+  while (c->hit && c->hit_off < (size_t)c->hit->content_length)
+  {
+    n = write(c->client.fd, c->hit->response_ptr + c->hit->header_length + c->hit_off,
+              c->hit->content_length - c->hit_off);
+    if (n < 0)
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    c->hit_off += n;
+  }
+  return 1;
+}
+
+// 논블로킹 connect 완료 확인 후 요청 전송 상태로 전환
+static int finish_connect(conn_t *c)
+{
+  int err = 0;
+  socklen_t len = sizeof(err);
+
+  if (getsockopt(c->server.fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err)
+  {
+    origin_failed(c, "connect");
+    return 0;
+  }
+  c->state = ST_SEND_REQUEST;
+  return 0;
+}
+
+// 재작성한 요청을 서버로 전송. 다 보내면 응답 중계 상태로 전환
+static int send_request(conn_t *c)
+{
+  int rc = flush_buf(c, c->server.fd);
+
+  if (rc <= 0)
+    return rc;
+  c->state = ST_RELAY;
+  c->resp = Malloc(MAX_OBJECT_SIZE + MAXBUF + 1);
+  c->resp_len = 0;
+  ev_set(&c->server, EPOLLIN);
+  return 0;
+}
+
+// 서버 응답을 읽어 클라이언트로 전달. 클라이언트가 느리면 서버 읽기를 멈추고 쓰기 가능을 기다림
+static int relay_response(conn_t *c)
+{
+  ssize_t n;
+  int rc;
+
+  if (c->cap < EV_RELAY_BUFSIZE)
+  {
+    c->buf = Realloc(c->buf, EV_RELAY_BUFSIZE);
+    c->cap = EV_RELAY_BUFSIZE;
+  }
+
+  while (1)
+  {
+    n = read(c->server.fd, c->buf, c->cap);
+    if (n == 0) // 서버가 연결을 닫음 → 응답 완료
+    {
+      if (c->key)
+        cache_count(0, c->relayed);
+      store_response(c);
+      return -1;
+    }
+    if (n < 0)
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+    // 응답 첫 조각이 5xx이고 만료된 사본이 stale-if-error 기간 안이면 에러를 버리고 사본으로 응답
+    if (c->stale && c->resp && c->resp_len == 0 && n > 9 && !strncmp(c->buf, "HTTP/", 5) && c->buf[9] == '5' &&
+        cache_within_sie(c->stale))
+    {
+      free(c->resp);
+      c->resp = NULL;
+      origin_failed(c, "response");
+      return 0;
+    }
+
+    // 캐시 가능한 크기 안이면 사본 유지, 넘치면 포기
+    if (c->resp && c->resp_len + n <= MAX_OBJECT_SIZE + MAXBUF)
+    {
+      memcpy(c->resp + c->resp_len, c->buf, n);
+      c->resp_len += n;
+    }
+    else
+    {
+      free(c->resp);
+      c->resp = NULL;
+    }
+
+    c->relayed += n;
+    c->len = n;
+    c->off = 0;
+    if ((rc = flush_buf(c, c->client.fd)) < 0)
+      return -1;
+    if (rc == 0) // 클라이언트 송신 버퍼가 가득 참
+    {
+      ev_set(&c->server, 0);
+      ev_set(&c->client, EPOLLOUT);
+      return 0;
+    }
+  }
+}
+
+// 중계 중 밀린 데이터를 클라이언트로 보낸 뒤 다시 서버 읽기 재개
+static int drain_to_client(conn_t *c)
+{
+  int rc = flush_buf(c, c->client.fd);
+
+  if (rc <= 0)
+    return rc;
+  ev_set(&c->client, 0);
+  ev_set(&c->server, EPOLLIN);
+  return 0;
+}
+
+// 엔드포인트 이벤트를 현재 상태에 맞는 처리 함수로 분배. -1이면 연결 종료
+static int dispatch(endpoint_t *ep, unsigned events)
+{
+  conn_t *c = ep->conn;
+  int is_client = (ep == &c->client);
+
+  if (events & EPOLLERR)
+    return -1;
+
+  switch (c->state)
+  {
+  case ST_READ_REQUEST:
+    return is_client ? read_request(c) : -1;
+  case ST_CONNECT:
+    if (is_client)
+      return -1;
+    if (finish_connect(c) < 0)
+      return -1;
+    return c->state == ST_SEND_REQUEST ? send_request(c) : 0;
+  case ST_SEND_REQUEST:
+    return is_client ? -1 : send_request(c);
+  case ST_RELAY:
+    return is_client ? drain_to_client(c) : relay_response(c);
+  case ST_WRITE_CLIENT:
+    if (!is_client)
+      return -1;
+    return write_client(c) == 0 ? 0 : -1; // 다 보냈거나 에러면 종료
+  }
+  return -1;
+}
+
+// 리스닝 소켓에서 대기 중인 연결을 모두 수락해 요청 읽기 상태로 등록
+static void accept_clients(int listenfd)
+{
+  int fd;
+  conn_t *c;
+
+  while ((fd = accept(listenfd, NULL, NULL)) >= 0)
+  {
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    c = Calloc(1, sizeof(conn_t));
+    c->state = ST_READ_REQUEST;
+    c->client.conn = c->server.conn = c;
+    c->client.fd = fd;
+    c->server.fd = -1;
+    ev_set(&c->client, EPOLLIN);
+  }
+}
+
+// 이벤트 루프 스레드 본체: 각 스레드가 자신의 epoll 인스턴스로 리스닝 소켓을 공유
+static void *event_loop(void *vargp)
+{
+  int listenfd = *(int *)vargp;
+  struct epoll_event events[EV_MAX_EVENTS], ev;
+  int i, n;
+
+  if ((loop_epfd = epoll_create1(0)) < 0)
+    unix_error("epoll_create1 error");
+
+  // EPOLLEXCLUSIVE: 새 연결마다 모든 루프가 깨어나는 thundering herd 방지
+  ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+  ev.data.ptr = NULL;
+  if (epoll_ctl(loop_epfd, EPOLL_CTL_ADD, listenfd, &ev) < 0)
+    unix_error("epoll_ctl error");
+
+  while (1)
+  {
+    if ((n = epoll_wait(loop_epfd, events, EV_MAX_EVENTS, -1)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      unix_error("epoll_wait error");
+    }
+    for (i = 0; i < n; i++)
+    {
+      endpoint_t *ep = events[i].data.ptr;
+      if (!ep)
+        accept_clients(listenfd);
+      else if (dispatch(ep, events[i].events) < 0)
+        conn_close(ep->conn);
+    }
+  }
+  return NULL;
+}
+
+void run_event_loops(int listenfd, int nthreads)
+{
+  static int shared_listenfd;
+  struct rlimit rl;
+  pthread_t tid;
+  int i;
+
+  // 만 단위 동시 연결을 위해 fd 한도를 hard limit까지 올림
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+  {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+
+  shared_listenfd = listenfd;
+  fcntl(listenfd, F_SETFL, fcntl(listenfd, F_GETFL) | O_NONBLOCK);
+
+  for (i = 1; i < nthreads; i++)
+  {
+    Pthread_create(&tid, NULL, event_loop, &shared_listenfd);
+    Pthread_detach(tid);
+  }
+  event_loop(&shared_listenfd); // 메인 스레드도 루프 하나를 담당
+}
@@ -0,0 +1,9 @@
+//webproxy-lab/sweeetpotatooo/event.h
+#ifndef __EVENT_H__
+#define __EVENT_H__
+
+// epoll 기반 이벤트 루프 엔진 (--engine=epoll)
+// nthreads개의 루프 스레드가 논블로킹 클라이언트/서버 소켓을 상태 기계로 처리한다. 반환하지 않음.
+void run_event_loops(int listenfd, int nthreads);
+
+#endif /* __EVENT_H__ */
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include "csapp.h"
+#include "flight.h"
+#include "outbuf.h"
+
+#define FLIGHT_BUCKETS 64 // 진행 중 요청 해시 버킷 수
+
+// 흐름
+// flight_join(): 같은 키의 진행 중 요청이 있으면 follower로 합류, 없으면 새로 만들고 leader가 됨
+// leader: 원 서버 요청 → 저장 가능한 응답이면 flight_begin()으로 헤더를 알림
+//         기다리는 follower가 있을 때만 나눠 받기로 하고 바디를 받는 대로 flight_append() (없으면 블록을 쌓지 않음)
+//         → flight_complete() → 캐시 저장 → flight_finish()로 결과(참조)를 기다리던 follower마다 하나씩 나눠 줌
+// follower: flight_wait()로 헤더(또는 종료)를 기다림
+//           헤더가 왔으면 flight_stream()으로 지금까지 받은 바이트를 보내고 이후 leader를 따라가며 전송
+//           끝났으면 결과를 받아 send_cache() → release_cache(), 결과가 NULL이면(에러, 캐싱 불가 응답) 각자 원 서버로 요청
+//           (헤더 이후에 합류했는데 leader가 나눠 받지 않기로 했으면 끝날 때까지 기다림)
+// 쌓인 바디는 마지막 참조(leader 또는 전송 중인 follower)가 반납될 때 해제된다
+
+static flight_t *buckets[FLIGHT_BUCKETS];
+static pthread_mutex_t flight_lock = PTHREAD_MUTEX_INITIALIZER; // 합류/종료는 짧으므로 전역 락 하나
+
+static unsigned hash_str(const char *s)
+{
+  unsigned h = 5381;
+
+  while (*s)
+    h = h * 33 + (unsigned char)*s++;
+  return h;
+}
+
+// 참조 하나 반납 (flight_lock 안에서 호출), 마지막이면 해제
+static void put_flight(flight_t *f)
+{
+  flight_block_t *b;
+
+  if (--f->refs == 0)
+  {
+    while ((b = f->head))
+    {
+      f->head = b->next;
+      free(b);
+    }
+    free(f->hdrs);
+    if (f->result)
+      release_cache(f->result);
+    pthread_cond_destroy(&f->done);
+    free(f);
+  }
+}
+
+// key에 대한 진행 중 요청에 합류. 새로 만들었으면 *leader = 1
+flight_t *flight_join(char *key, int *leader)
+{
+  flight_t **pp = &buckets[hash_str(key) % FLIGHT_BUCKETS];
+  flight_t *f;
+
+  pthread_mutex_lock(&flight_lock);
+  for (f = *pp; f; f = f->next)
+    if (!strcmp(f->key, key))
+      break;
+
+  if (f)
+  {
+    f->refs++;
+    *leader = 0;
+  }
+  else
+  {
+    f = Calloc(1, sizeof(flight_t));
+    strcpy(f->key, key);
+    pthread_cond_init(&f->done, NULL);
+    f->refs = 1;
+    f->next = *pp;
+    *pp = f;
+    *leader = 1;
+  }
+  pthread_mutex_unlock(&flight_lock);
+  return f;
+}
+
+// follower: leader가 헤더를 받거나 끝날 때까지 기다림
+// 따라 받을 수 있으면 1 (참조를 유지한 채 flight_stream으로 전송),
+// 끝났으면 0과 함께 *result에 결과 (참조 하나 보유, 없거나 도중에 실패했으면 NULL)
+int flight_wait(flight_t *f, CachedObject **result)
+{
+  pthread_mutex_lock(&flight_lock);
+  while (!f->finished && !f->streaming)
+    pthread_cond_wait(&f->done, &flight_lock);
+  if (f->streaming && !f->failed && (f->complete || !f->finished))
+  {
+    pthread_mutex_unlock(&flight_lock);
+    return 1;
+  }
+  if ((*result = f->result))
+    hold_cache(*result);  // follower 몫의 참조
+  put_flight(f);
+  pthread_mutex_unlock(&flight_lock);
+  return 0;
+}
+
+// follower: 헤더 블록을 보내고 바디를 leader가 받은 데까지 보낸 뒤, 늘어날 때마다 깨어나 이어서 보냄
+// 길이를 모르는 바디면 끝을 연결 종료로 알린다. 참조를 반납하고, 온전히 보내 연결을 계속 쓸 수 있으면 1
+int flight_stream(flight_t *f, int clientfd, int keep_alive)
+{
+  outbuf_t ob;
+  flight_block_t *b = NULL;
+  long pos = 0, len, off, n;
+  size_t hdr_bytes;
+  int ok;
+
+  // 헤더 관련 필드는 flight_begin 이후 바뀌지 않음
+  if (f->content_length < 0)
+    keep_alive = 0;
+  outbuf_init(&ob);
+  outbuf_append_ref(&ob, f->hdrs, f->hdrs_len);
+  if (f->age > 0)
+    outbuf_printf(&ob, "Age: %ld\r\n", f->age);
+  outbuf_printf(&ob, "Connection: %s\r\n\r\n", keep_alive ? "keep-alive" : "close");
+  hdr_bytes = outbuf_size(&ob);
+  ok = outbuf_write(&ob, clientfd, f->content_length != 0) == 0;
+  outbuf_free(&ob);
+
+  pthread_mutex_lock(&flight_lock);
+  while (ok)
+  {
+    while (f->len == pos && !f->complete && !f->failed && !f->finished)
+      pthread_cond_wait(&f->done, &flight_lock);
+    if ((len = f->len) == pos)
+    {
+      ok = f->complete;  // 다 보냈거나, leader가 도중에 실패
+      break;
+    }
+
+    // len 앞쪽 블록은 바뀌지 않으므로 락 없이 전송
+    pthread_mutex_unlock(&flight_lock);
+    while (ok && pos < len)
+    {
+      off = pos % FLIGHT_BLOCK;
+      if (!b)
+        b = f->head;
+      else if (off == 0)
+        b = b->next;
+      n = len - pos < FLIGHT_BLOCK - off ? len - pos : FLIGHT_BLOCK - off;
+      ok = rio_writen(clientfd, b->data + off, n) == n;
+      pos += n;
+    }
+    pthread_mutex_lock(&flight_lock);
+  }
+  put_flight(f);
+  pthread_mutex_unlock(&flight_lock);
+
+  if (ok)
+    cache_count(1, hdr_bytes + pos);  // 원 서버에 따로 가지 않았으므로 히트로 셈
+  return ok && keep_alive;
+}
+
+// leader: 저장 가능한 응답의 헤더를 받았음. 기다리는 follower가 있으면 이제부터 따라 받을 수 있고 1
+// 아무도 없으면 0 (바디를 flight에 쌓지 않으므로 leader는 큰 응답도 바로 흘려보내고, 이후 합류한 follower는 결과를 기다림)
+int flight_begin(flight_t *f, char *hdrs, int hdrs_len, long age, long content_length)
+{
+  pthread_mutex_lock(&flight_lock);
+  if (f->refs == 1)
+  {
+    pthread_mutex_unlock(&flight_lock);
+    return 0;
+  }
+  f->hdrs = Malloc(hdrs_len);
+  memcpy(f->hdrs, hdrs, hdrs_len);
+  f->hdrs_len = hdrs_len;
+  f->age = age;
+  f->content_length = content_length;
+  f->streaming = 1;
+  pthread_cond_broadcast(&f->done);
+  pthread_mutex_unlock(&flight_lock);
+  return 1;
+}
+
+// leader: 받은 바디 n바이트를 이어 붙이고 기다리던 follower를 깨움
+// 나눠 받을 수 있는 크기(FLIGHT_MAX_SHARED)를 넘으면 follower들을 실패시키고 -1 (이후로는 붙이지 않음)
+int flight_append(flight_t *f, char *p, long n)
+{
+  long end = f->len, off, k;  // len과 블록 목록은 leader만 바꿈
+
+  if (end + n > FLIGHT_MAX_SHARED)
+  {
+    pthread_mutex_lock(&flight_lock);
+    f->failed = 1;
+    pthread_cond_broadcast(&f->done);
+    pthread_mutex_unlock(&flight_lock);
+    return -1;
+  }
+
+  // follower는 len 앞쪽만 읽으므로 복사와 블록 연결은 락 없이
+  while (n > 0)
+  {
+    if ((off = end % FLIGHT_BLOCK) == 0)
+    {
+      flight_block_t *b = Malloc(sizeof(flight_block_t));
+
+      b->next = NULL;
+      if (f->tail)
+        f->tail->next = b;
+      else
+        f->head = b;
+      f->tail = b;
+    }
+    k = n < FLIGHT_BLOCK - off ? n : FLIGHT_BLOCK - off;
+    memcpy(f->tail->data + off, p, k);
+    p += k;
+    n -= k;
+    end += k;
+  }
+
+  pthread_mutex_lock(&flight_lock);
+  f->len = end;
+  pthread_cond_broadcast(&f->done);
+  pthread_mutex_unlock(&flight_lock);
+  return 0;
+}
+
+// leader: 바디를 끝까지 받았음 (따라 받던 follower들이 마지막 바이트까지 보내고 끝낼 수 있음)
+void flight_complete(flight_t *f)
+{
+  pthread_mutex_lock(&flight_lock);
+  f->complete = 1;
+  pthread_cond_broadcast(&f->done);
+  pthread_mutex_unlock(&flight_lock);
+}
+
+// leader: 테이블에서 빼고 result의 참조를 flight 몫으로 하나 잡은 뒤 깨움 (기다리던 follower는 각자 참조를 더 잡아 감)
+// result는 leader가 참조를 가진 상태로 넘기고, leader는 이후 자기 참조를 직접 반납한다
+// 바디를 끝까지 받지 못했으면(flight_complete 전) 따라 받던 follower들은 실패로 끝난다
+void flight_finish(flight_t *f, CachedObject *result)
+{
+  flight_t **pp = &buckets[hash_str(f->key) % FLIGHT_BUCKETS];
+
+  pthread_mutex_lock(&flight_lock);
+  while (*pp != f)
+    pp = &(*pp)->next;
+  *pp = f->next;   // 이후 같은 키 요청은 캐시에서 찾거나 새 flight를 만든다
+
+  f->finished = 1;
+  f->result = result;
+  if (result)
+    hold_cache(result);  // 마지막 참조가 반납될 때 put_flight가 놓음
+  pthread_cond_broadcast(&f->done);
+  put_flight(f);
+  pthread_mutex_unlock(&flight_lock);
+}
@@ -0,0 +1,49 @@
+//webproxy-lab/sweeetpotatooo/flight.h
+#ifndef __FLIGHT_H__
+#define __FLIGHT_H__
+
+#include "csapp.h"
+#include "cache.h"
+
+#define FLIGHT_BLOCK (64 * 1024)              // 받는 중인 바디를 쌓는 블록 크기 (블록은 옮기지 않으므로 follower가 락 없이 읽음)
+#define FLIGHT_MAX_SHARED (16 * 1024 * 1024)  // follower와 나눠 받을 수 있는 바디 최대 크기 (넘으면 각자 원 서버로)
+
+// 받는 중인 바디 한 조각 (leader만 이어 붙이고, len 앞쪽은 바뀌지 않음)
+typedef struct flight_block
+{
+  struct flight_block *next;
+  char data[FLIGHT_BLOCK];
+} flight_block_t;
+
+// 같은 키에 대한 진행 중인 원 서버 요청 하나 (single-flight)
+// 처음 미스한 스레드(leader)가 원 서버에서 받아오고, 뒤이어 온 스레드(follower)는
+// leader가 저장 가능한 응답의 헤더를 받는 순간부터 지금까지 받은 바이트를 보내고 이후로는 leader를 따라가며 보낸다.
+// 헤더를 받을 때 기다리는 follower가 없으면 바디를 쌓지 않으며, 그 뒤에 합류한 follower는 결과를 기다린다.
+typedef struct flight
+{
+  char key[MAXLINE];
+  pthread_cond_t done;   // 헤더 도착, 바디 증가, 종료마다 broadcast
+  int finished;
+  int refs;              // leader + 합류한 follower 수, 0이 되면 해제
+  CachedObject *result;  // 캐시에 저장된 결과 (저장하지 못했으면 NULL)
+  int streaming;         // 헤더를 받아 follower가 따라 받을 수 있음
+  int complete;          // 바디를 끝까지 받았음 (finished인데 0이면 도중에 실패)
+  int failed;            // 나눠 받을 수 있는 크기를 넘어 follower들은 포기 (leader는 계속 받음)
+  char *hdrs;            // 헤더 블록 (Age/Connection 제외)
+  int hdrs_len;
+  long age;              // 원 서버 응답의 Age
+  long content_length;   // 모르면 -1 (follower는 연결 종료로 끝을 알림)
+  long len;              // 지금까지 받은 바디 길이
+  flight_block_t *head, *tail;
+  struct flight *next;
+} flight_t;
+
+flight_t *flight_join(char *key, int *leader);
+int flight_wait(flight_t *f, CachedObject **result);
+int flight_stream(flight_t *f, int clientfd, int keep_alive);
+int flight_begin(flight_t *f, char *hdrs, int hdrs_len, long age, long content_length);
+int flight_append(flight_t *f, char *p, long n);
+void flight_complete(flight_t *f);
+void flight_finish(flight_t *f, CachedObject *result);
+
+#endif /* __FLIGHT_H__ */
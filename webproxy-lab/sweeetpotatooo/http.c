@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include "csapp.h"
+#include "proxy.h"
+#include "http.h"
+
+// HTTP/1.x 요청 라인/헤더 파서
+// 요청 라인과 헤더 줄을 입력 버퍼 안에서 그대로 잘라 (이름, 값) 구간으로 나누고,
+// 특별히 다루는 헤더는 이름 길이와 첫 글자로 만든 완전 해시 테이블에서 한 번의 비교로 찾는다.
+// 재작성 결과는 호출자의 출력 버퍼 하나에 이어 붙여 원 서버로 한 번에 보낸다.
+
+#define HDR_TABLE_SIZE 64
+
+// (첫 글자 + 마지막 글자 * 5 + 이름 길이) % 64 는 아래 이름들에 대해 충돌이 없다
+#define HDR_HASH(first, last, len) \
+  (((unsigned)((first) | 0x20) + (unsigned)((last) | 0x20) * 5 + (unsigned)(len)) & (HDR_TABLE_SIZE - 1))
+
+static const struct
+{
+  const char *name;
+  int len;
+  int id;
+} hdr_table[HDR_TABLE_SIZE] = {
+    [3] = {"user-agent", 10, HDR_USER_AGENT},
+    [8] = {"transfer-encoding", 17, HDR_TRANSFER_ENCODING},
+    [12] = {"cache-control", 13, HDR_CACHE_CONTROL},
+    [19] = {"connection", 10, HDR_CONNECTION},
+    [29] = {"age", 3, HDR_AGE},
+    [33] = {"date", 4, HDR_DATE},
+    [38] = {"proxy-connection", 16, HDR_PROXY_CONNECTION},
+    [40] = {"content-type", 12, HDR_CONTENT_TYPE},
+    [43] = {"expires", 7, HDR_EXPIRES},
+    [44] = {"etag", 4, HDR_ETAG},
+    [45] = {"last-modified", 13, HDR_LAST_MODIFIED},
+    [46] = {"keep-alive", 10, HDR_KEEP_ALIVE},
+    [48] = {"host", 4, HDR_HOST},
+    [51] = {"if-modified-since", 17, HDR_IF_MODIFIED_SINCE},
+    [57] = {"content-length", 14, HDR_CONTENT_LENGTH},
+    [62] = {"if-none-match", 13, HDR_IF_NONE_MATCH},
+};
+
+static int header_id(char *name, int len)
+{
+  int i;
+
+  if (len == 0)
+    return HDR_OTHER;
+  i = HDR_HASH(name[0], name[len - 1], len);
+  if (hdr_table[i].len == len && !strncasecmp(hdr_table[i].name, name, len))
+    return hdr_table[i].id;
+  return HDR_OTHER;
+}
+
+// "METHOD URI VERSION" 을 제자리에서 잘라 각 토큰을 NUL로 끝냄 (version은 없을 수 있음)
+// 성공 0, method나 uri가 없으면 -1
+int http_parse_request_line(char *line, char **method, char **uri, char **version)
+{
+  char *tok[3] = {"", "", ""};
+  char *p = line;
+  int n;
+
+  for (n = 0; n < 3; n++)
+  {
+    while (*p == ' ' || *p == '\t')
+      p++;
+    if (*p == '\0' || *p == '\r' || *p == '\n')
+      break;
+    tok[n] = p;
+    while (*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+      p++;
+    if (*p)
+      *p++ = '\0';
+  }
+  *method = tok[0];
+  *uri = tok[1];
+  *version = tok[2];
+  return n >= 2 ? 0 : -1;
+}
+
+// 헤더 한 줄(line, len바이트, 줄바꿈 포함)을 이름/값 구간으로 나눔
+// 헤더면 1, 헤더 끝(빈 줄)이면 0, 콜론이 없는 잘못된 줄이면 -1
+int http_parse_header(char *line, int len, http_header_t *h)
+{
+  char *end = line + len, *colon, *v;
+
+  // 줄바꿈 제거
+  if (end > line && end[-1] == '\n')
+    end--;
+  if (end > line && end[-1] == '\r')
+    end--;
+  if (end == line)
+    return 0;
+
+  if (!(colon = memchr(line, ':', end - line)))
+    return -1;
+  h->name.p = line;
+  h->name.len = colon - line;
+
+  // 값 앞뒤 공백 제거
+  for (v = colon + 1; v < end && (*v == ' ' || *v == '\t'); v++)
+    ;
+  while (end > v && (end[-1] == ' ' || end[-1] == '\t'))
+    end--;
+  h->value.p = v;
+  h->value.len = end - v;
+  h->id = header_id(h->name.p, h->name.len);
+  return 1;
+}
+
+// 쉼표로 구분된 값 목록에 token이 있는지 (대소문자 무시), 예: "keep-alive, Upgrade"
+int http_value_has(http_slice_t *v, const char *token)
+{
+  int tlen = strlen(token);
+  char *p = v->p, *end = v->p + v->len, *q;
+
+  while (p < end)
+  {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == ','))
+      p++;
+    for (q = p; q < end && *q != ','; q++)
+      ;
+    while (q > p && (q[-1] == ' ' || q[-1] == '\t'))
+      q--;
+    if (q - p == tlen && !strncasecmp(p, token, tlen))
+      return 1;
+    while (p < end && *p != ',')
+      p++;
+  }
+  return 0;
+}
+
+// 쉼표로 구분된 값 목록에서 "name=숫자" 형태의 값을 찾음, 예: Cache-Control의 "max-age=60"
+// 없거나 숫자가 아니면 -1
+long http_value_param(http_slice_t *v, const char *name)
+{
+  int nlen = strlen(name);
+  char *p = v->p, *end = v->p + v->len;
+  long val;
+
+  while (p < end)
+  {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == ','))
+      p++;
+    if (end - p > nlen && !strncasecmp(p, name, nlen) && p[nlen] == '=')
+    {
+      p += nlen + 1;
+      if (p < end && *p == '"') // max-age="60" 도 허용
+        p++;
+      if (p == end || *p < '0' || *p > '9')
+        return -1;
+      for (val = 0; p < end && *p >= '0' && *p <= '9'; p++)
+        val = val < 100000000000L ? val * 10 + (*p - '0') : val; // 터무니없이 큰 값은 그대로 둠
+      return val;
+    }
+    while (p < end && *p != ',')
+      p++;
+  }
+  return -1;
+}
+
+// HTTP 날짜(IMF-fixdate, 예: "Sun, 06 Nov 1994 08:49:37 GMT")를 time_t로, 형식이 다르면 -1
+time_t http_parse_date(http_slice_t *v)
+{
+  static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  char buf[64], mon[4];
+  struct tm tm = {0};
+  const char *m;
+
+  if (v->len >= (int)sizeof(buf))
+    return -1;
+  memcpy(buf, v->p, v->len);
+  buf[v->len] = '\0';
+  if (sscanf(buf, "%*3s, %2d %3s %4d %2d:%2d:%2d GMT", &tm.tm_mday, mon, &tm.tm_year, &tm.tm_hour, &tm.tm_min,
+             &tm.tm_sec) != 6 ||
+      strlen(mon) != 3 || !(m = strstr(months, mon)) || (m - months) % 3)
+    return -1;
+  tm.tm_mon = (m - months) / 3;
+  tm.tm_year -= 1900;
+  return timegm(&tm);
+}
+
+void http_rewrite_init(http_rewrite_t *rw, int client_keep_alive)
+{
+  rw->seen = 0;
+  rw->client_keep_alive = client_keep_alive;
+}
+
+// 요청 헤더 하나를 원 서버로 보낼 형태로 out에 씀, 쓴 길이 반환
+// keep_alive: 원 서버와 지속 연결(HTTP/1.1)을 쓰면 Connection은 keep-alive로, Proxy-Connection은 제거
+int http_rewrite_header(http_rewrite_t *rw, http_header_t *h, char *line, int len, char *out, int keep_alive)
+{
+  switch (h->id)
+  {
+  case HDR_CONNECTION:
+  case HDR_PROXY_CONNECTION:
+    // 클라이언트 쪽 연결 유지 여부
+    if (http_value_has(&h->value, "close"))
+      rw->client_keep_alive = 0;
+    else if (http_value_has(&h->value, "keep-alive"))
+      rw->client_keep_alive = 1;
+    rw->seen |= 1 << h->id;
+
+    // 원 서버 쪽은 프록시가 정함
+    if (h->id == HDR_CONNECTION)
+      return sprintf(out, "Connection: %s\r\n", keep_alive ? "keep-alive" : "close");
+    return keep_alive ? 0 : sprintf(out, "Proxy-Connection: close\r\n");
+
+  case HDR_KEEP_ALIVE: // 클라이언트와의 연결에만 해당하는 hop-by-hop 헤더
+    return 0;
+
+  case HDR_USER_AGENT: // 고정된 문자열로 교체
+    rw->seen |= 1 << h->id;
+    len = strlen(user_agent_hdr);
+    memcpy(out, user_agent_hdr, len);
+    return len;
+
+  case HDR_HOST:
+  case HDR_IF_NONE_MATCH:
+  case HDR_IF_MODIFIED_SINCE:
+    rw->seen |= 1 << h->id;
+    /* fall through */
+  default: // 그 외 헤더는 원래 줄 그대로
+    memcpy(out, line, len);
+    return len;
+  }
+}
+
+// 빠진 필수 헤더를 보충하고 헤더 끝 빈 줄까지 out에 씀, 쓴 길이 반환
+int http_rewrite_finish(http_rewrite_t *rw, char *out, int keep_alive, char *hostname, char *port)
+{
+  int len = 0;
+
+  if (!(rw->seen & (1 << HDR_PROXY_CONNECTION)) && !keep_alive)
+    len += sprintf(out + len, "Proxy-Connection: close\r\n");
+  if (!(rw->seen & (1 << HDR_CONNECTION)))
+    len += sprintf(out + len, "Connection: %s\r\n", keep_alive ? "keep-alive" : "close");
+  if (!(rw->seen & (1 << HDR_HOST)))
+    len += sprintf(out + len, "Host: %s:%s\r\n", hostname, port);
+  if (!(rw->seen & (1 << HDR_USER_AGENT)))
+    len += sprintf(out + len, "%s", user_agent_hdr);
+
+  // 헤더 끝을 알리는 빈 줄
+  len += sprintf(out + len, "\r\n");
+  return len;
+}
@@ -0,0 +1,58 @@
+//webproxy-lab/sweeetpotatooo/http.h
+#ifndef __HTTP_H__
+#define __HTTP_H__
+
+#include "csapp.h"
+
+// 입력 버퍼 안의 한 구간 (복사하지 않음, NUL 종료 아님)
+typedef struct
+{
+  char *p;
+  int len;
+} http_slice_t;
+
+// 프록시가 다르게 처리하는 헤더들. 나머지는 HDR_OTHER로 그대로 전달
+enum
+{
+  HDR_OTHER,
+  HDR_HOST,
+  HDR_CONNECTION,
+  HDR_PROXY_CONNECTION,
+  HDR_KEEP_ALIVE,
+  HDR_USER_AGENT,
+  HDR_CONTENT_LENGTH,
+  HDR_TRANSFER_ENCODING,
+  HDR_CONTENT_TYPE,
+  HDR_ETAG,
+  HDR_LAST_MODIFIED,
+  HDR_CACHE_CONTROL,
+  HDR_EXPIRES,
+  HDR_AGE,
+  HDR_DATE,
+  HDR_IF_NONE_MATCH,
+  HDR_IF_MODIFIED_SINCE,
+};
+
+typedef struct
+{
+  http_slice_t name, value;  // 값은 앞뒤 공백 제거
+  int id;                    // HDR_*
+} http_header_t;
+
+// 요청 헤더를 원 서버용으로 다시 쓰는 동안의 상태
+typedef struct
+{
+  int seen;               // 이미 나온 필수/조건부 헤더 (1 << HDR_*)
+  int client_keep_alive;  // 클라이언트 Connection/Proxy-Connection 값 반영
+} http_rewrite_t;
+
+int http_parse_request_line(char *line, char **method, char **uri, char **version);
+int http_parse_header(char *line, int len, http_header_t *h);
+int http_value_has(http_slice_t *v, const char *token);
+long http_value_param(http_slice_t *v, const char *name);
+time_t http_parse_date(http_slice_t *v);
+void http_rewrite_init(http_rewrite_t *rw, int client_keep_alive);
+int http_rewrite_header(http_rewrite_t *rw, http_header_t *h, char *line, int len, char *out, int keep_alive);
+int http_rewrite_finish(http_rewrite_t *rw, char *out, int keep_alive, char *hostname, char *port);
+
+#endif /* __HTTP_H__ */
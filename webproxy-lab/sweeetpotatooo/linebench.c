@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "csapp.h"
+
+// 요청 헤더 줄 읽기 마이크로벤치마크 (make linebench)
+// 브라우저가 보내는 전형적인 요청 헤더(13줄) 블록을 임시 파일에 BLOCKS번 써 두고,
+// 파일을 처음부터 줄 단위로 읽는 데 걸린 시간을 줄마다 ns로 출력한다.
+//
+// 사용법: ./linebench
+//
+// bytewise는 예전 rio_readlineb (rio_read를 한 바이트씩 호출)를 그대로 옮긴 것으로 비교 기준이다.
+// readlineb는 지금의 rio_readlineb (memchr로 줄 끝을 찾아 한 번에 복사), peeklineb는 복사 없이 버퍼 안을 가리키는 rio_peeklineb.
+// 세 방식이 읽은 줄 수와 바이트 수가 같은지도 확인한다.
+
+#define BLOCKS 200000  // 헤더 블록 수
+
+static const char *header_block =
+    "GET http://www.example.com/static/js/app.8c1f0a77.js HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:121.0) Gecko/20100101 Firefox/121.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Referer: http://www.example.com/\r\n"
+    "Cookie: session=8c1f0a77e2b94d3e9a51c6b0f2d8e4a1; theme=dark; _ga=GA1.2.1234567890.1700000000\r\n"
+    "Connection: keep-alive\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "If-None-Match: \"5f2b-61a8c3e4d2f00\"\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "\r\n";
+
+// 예전 rio_read: 버퍼가 비었을 때만 read()로 채우고 min(n, rio_cnt) 바이트를 복사
+static ssize_t bytewise_read(rio_t *rp, char *usrbuf, size_t n)
+{
+  int cnt;
+
+  while (rp->rio_cnt <= 0)
+  {
+    rp->rio_cnt = read(rp->rio_fd, rp->rio_buf, sizeof(rp->rio_buf));
+    if (rp->rio_cnt < 0)
+    {
+      if (errno != EINTR)
+        return -1;
+    }
+    else if (rp->rio_cnt == 0)
+      return 0;
+    else
+      rp->rio_bufptr = rp->rio_buf;
+  }
+  cnt = n;
+  if (rp->rio_cnt < n)
+    cnt = rp->rio_cnt;
+  memcpy(usrbuf, rp->rio_bufptr, cnt);
+  rp->rio_bufptr += cnt;
+  rp->rio_cnt -= cnt;
+  return cnt;
+}
+
+// 예전 rio_readlineb: 한 바이트씩 읽어 줄 끝을 찾음
+static ssize_t bytewise_readlineb(rio_t *rp, void *usrbuf, size_t maxlen)
+{
+  int n, rc;
+  char c, *bufp = usrbuf;
+
+  for (n = 1; n < maxlen; n++)
+  {
+    if ((rc = bytewise_read(rp, &c, 1)) == 1)
+    {
+      *bufp++ = c;
+      if (c == '\n')
+      {
+        n++;
+        break;
+      }
+    }
+    else if (rc == 0)
+    {
+      if (n == 1)
+        return 0;
+      else
+        break;
+    }
+    else
+      return -1;
+  }
+  *bufp = 0;
+  return n - 1;
+}
+
+// fd를 처음부터 끝까지 줄 단위로 읽음 (mode 0: bytewise, 1: readlineb, 2: peeklineb)
+static void run(int fd, int mode, const char *name)
+{
+  struct timespec t0, t1;
+  char line[MAXLINE], *p;
+  long lines = 0, bytes = 0;
+  ssize_t n;
+  rio_t rio;
+
+  lseek(fd, 0, SEEK_SET);
+  rio_readinitb(&rio, fd);
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  while ((n = mode == 0   ? bytewise_readlineb(&rio, line, MAXLINE)
+              : mode == 1 ? rio_readlineb(&rio, line, MAXLINE)
+                          : rio_peeklineb(&rio, &p)) > 0)
+  {
+    lines++;
+    bytes += n;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  printf("%-10s %9ld %11ld %9.1f\n", name, lines, bytes,
+         ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / (lines ? lines : 1));
+}
+
+int main(void)
+{
+  char path[] = "/tmp/linebench.XXXXXX";
+  size_t len = strlen(header_block);
+  int fd;
+
+  if ((fd = mkstemp(path)) < 0)
+    unix_error("linebench: mkstemp error");
+  unlink(path);
+  for (int i = 0; i < BLOCKS; i++)
+    Rio_writen(fd, (void *)header_block, len);
+
+  printf("%-10s %9s %11s %9s\n", "reader", "lines", "bytes", "ns/line");
+  run(fd, 0, "bytewise");
+  run(fd, 1, "readlineb");
+  run(fd, 2, "peeklineb");
+  Close(fd);
+  return 0;
+}
@@ -0,0 +1,36 @@
+#!/usr/bin/python3
+
+# miss-client.py - Sends GETs through the proxy one after another, each
+#                  for a path it has not asked for before (always a cache
+#                  miss), on a new client connection, and reports the
+#                  request latency percentiles and request rate. Count the
+#                  connections the origin accepts to get the upstream
+#                  SYN rate.
+#
+# usage: miss-client.py <proxy port> <requests> <origin url prefix>
+#
+import socket
+import sys
+import time
+
+port, nreqs, prefix = int(sys.argv[1]), int(sys.argv[2]), sys.argv[3]
+host = prefix.split('/')[2]
+tag = '%x' % int(time.time() * 1000)
+latency = []
+
+begin = time.perf_counter()
+for i in range(nreqs):
+  url = '%s/miss-%s-%d' % (prefix, tag, i)
+  start = time.perf_counter()
+  s = socket.create_connection(('127.0.0.1', port))
+  s.sendall(('GET %s HTTP/1.0\r\nHost: %s\r\n\r\n' % (url, host)).encode())
+  while s.recv(65536):
+    pass
+  s.close()
+  latency.append(time.perf_counter() - start)
+elapsed = time.perf_counter() - begin
+
+latency.sort()
+pct = lambda p: latency[min(len(latency) - 1, int(p * len(latency)))] * 1000
+print('requests=%d %.0f req/s p50=%.2fms p90=%.2fms p99=%.2fms' %
+      (nreqs, nreqs / elapsed, pct(.5), pct(.9), pct(.99)))
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <sys/uio.h>
+#include "csapp.h"
+#include "outbuf.h"
+
+// 출력 버퍼 흐름
+// 요청/응답 헤더를 한 줄씩 보내면 줄마다 write 한 번, 때로는 TCP 세그먼트 하나가 된다.
+// 게다가 헤더와 바디를 따로 쓰면 지속 연결에서 Nagle + 지연 ACK가 겹쳐 응답마다 수십 ms씩 멈춘다.
+// 그래서 보낼 것을 모두 outbuf에 모은 뒤 outbuf_write()로 한 번에 내보낸다.
+
+
+void outbuf_init(outbuf_t *ob)
+{
+  ob->buf = ob->inline_buf;
+  ob->cap = OUTBUF_INLINE;
+  ob->len = 0;
+  ob->nseg = 0;
+}
+
+// 내용만 비우고 확장한 공간은 재사용
+void outbuf_reset(outbuf_t *ob)
+{
+  ob->len = 0;
+  ob->nseg = 0;
+}
+
+void outbuf_free(outbuf_t *ob)
+{
+  if (ob->buf != ob->inline_buf)
+    free(ob->buf);
+  outbuf_init(ob);
+}
+
+// 끝에 최소 n바이트를 바로 쓸 수 있는 위치 반환. 실제로 쓴 길이는 outbuf_commit()으로 알린다.
+char *outbuf_reserve(outbuf_t *ob, size_t n)
+{
+  if (ob->len + n > ob->cap)
+  {
+    size_t cap = ob->cap;
+
+    while (cap < ob->len + n)
+      cap *= 2;
+    if (ob->buf == ob->inline_buf)
+    {
+      ob->buf = Malloc(cap);
+      memcpy(ob->buf, ob->inline_buf, ob->len);
+    }
+    else
+      ob->buf = Realloc(ob->buf, cap);
+    ob->cap = cap;
+  }
+  return ob->buf + ob->len;
+}
+
+// reserve로 받은 자리에 쓴 n바이트를 확정. 직전 구간도 내부 데이터면 그 구간을 늘린다.
+void outbuf_commit(outbuf_t *ob, size_t n)
+{
+  if (!n)
+    return;
+  if (!ob->nseg || ob->seg[ob->nseg - 1].ref)
+  {
+    ob->seg[ob->nseg].ref = NULL;
+    ob->seg[ob->nseg].off = ob->len;
+    ob->seg[ob->nseg].len = 0;
+    ob->nseg++;
+  }
+  ob->seg[ob->nseg - 1].len += n;
+  ob->len += n;
+}
+
+// 마지막에 복사해 넣은 n바이트를 되돌림 (예: 요청 끝 빈 줄 앞에 헤더를 끼워 넣을 때). 되돌렸으면 0
+int outbuf_trim(outbuf_t *ob, size_t n)
+{
+  if (!ob->nseg || ob->seg[ob->nseg - 1].ref || ob->seg[ob->nseg - 1].len < n)
+    return -1;
+  ob->len -= n;
+  if (!(ob->seg[ob->nseg - 1].len -= n))
+    ob->nseg--;
+  return 0;
+}
+
+void outbuf_append(outbuf_t *ob, const void *data, size_t n)
+{
+  memcpy(outbuf_reserve(ob, n), data, n);
+  outbuf_commit(ob, n);
+}
+
+void outbuf_printf(outbuf_t *ob, const char *fmt, ...)
+{
+  va_list ap;
+  size_t room = 256;
+  int n;
+
+  while (1)
+  {
+    char *p = outbuf_reserve(ob, room);
+
+    va_start(ap, fmt);
+    n = vsnprintf(p, room, fmt, ap);
+    va_end(ap);
+    if (n < 0)
+      return;
+    if ((size_t)n < room)
+      break;
+    room = n + 1;
+  }
+  outbuf_commit(ob, n);
+}
+
+// data를 복사하지 않고 구간으로 추가 (outbuf_write까지 data가 유지돼야 함)
+// 구간이 모자라면 복사로 대신한다. 마지막 한 칸은 뒤따르는 내부 데이터 몫으로 남겨 둔다.
+void outbuf_append_ref(outbuf_t *ob, const void *data, size_t n)
+{
+  if (!n)
+    return;
+  if (ob->nseg > OUTBUF_MAXSEGS - 2)
+  {
+    outbuf_append(ob, data, n);
+    return;
+  }
+  ob->seg[ob->nseg].ref = data;
+  ob->seg[ob->nseg].off = 0;
+  ob->seg[ob->nseg].len = n;
+  ob->nseg++;
+}
+
+// 보낼 전체 바이트 수
+size_t outbuf_size(outbuf_t *ob)
+{
+  size_t n = 0;
+
+  for (int i = 0; i < ob->nseg; i++)
+    n += ob->seg[i].len;
+  return n;
+}
+
+// 모은 데이터를 fd로 전송 (버퍼 내용은 그대로 두므로 재시도 시 다시 보낼 수 있음)
+// more면 뒤에 곧 데이터가 이어진다는 뜻(MSG_MORE)으로 sendmsg를 써서 부분 프레임을 바로 내보내지 않게 한다.
+// 전부 보냈으면 0, 에러면 -1 (rio_writen처럼 프로세스를 종료하지 않음)
+int outbuf_write(outbuf_t *ob, int fd, int more)
+{
+  struct iovec iov[OUTBUF_MAXSEGS], *v = iov;
+  int nv = ob->nseg;
+  ssize_t n;
+
+  for (int i = 0; i < nv; i++)
+  {
+    iov[i].iov_base = (void *)(ob->seg[i].ref ? ob->seg[i].ref : ob->buf + ob->seg[i].off);
+    iov[i].iov_len = ob->seg[i].len;
+  }
+
+  while (nv > 0)
+  {
+    if (more)
+    {
+      struct msghdr msg = {.msg_iov = v, .msg_iovlen = nv};
+      n = sendmsg(fd, &msg, MSG_MORE);
+    }
+    else
+      n = writev(fd, v, nv);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+
+    // 부분 전송: 다 보낸 구간은 건너뛰고 걸친 구간은 앞을 잘라 이어서 보냄
+    while (nv > 0 && (size_t)n >= v->iov_len)
+    {
+      n -= v->iov_len;
+      v++, nv--;
+    }
+    if (nv > 0)
+    {
+      v->iov_base = (char *)v->iov_base + n;
+      v->iov_len -= n;
+    }
+  }
+  return 0;
+}
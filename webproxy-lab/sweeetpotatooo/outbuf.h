@@ -0,0 +1,39 @@
+//webproxy-lab/sweeetpotatooo/outbuf.h
+#ifndef __OUTBUF_H__
+#define __OUTBUF_H__
+
+#include "csapp.h"
+
+#define OUTBUF_INLINE 2048  // 구조체 안에 둔 기본 공간 (보통의 요청/응답 헤더는 힙 할당 없이 처리)
+#define OUTBUF_MAXSEGS 8    // writev 한 번에 보낼 최대 구간 수
+
+// 보낼 데이터를 모아 두었다가 시스템 콜 한 번으로 내보내는 출력 버퍼
+// outbuf_append/printf: 내부 공간에 복사 (끝 위치를 들고 있으므로 O(1) 추가, 공간은 두 배씩 확장)
+// outbuf_append_ref: 큰 바디처럼 이미 메모리에 있는 데이터는 복사하지 않고 구간으로만 기록 (write까지 유효해야 함)
+// outbuf_write: 모든 구간을 순서대로 writev 한 번(부분 전송 시에만 이어서)으로 전송
+typedef struct
+{
+  char *buf;          // 복사한 데이터 (처음엔 inline_buf, 넘치면 힙)
+  size_t len, cap;
+  struct
+  {
+    const char *ref;  // NULL이면 buf[off, off + len), 아니면 외부 데이터
+    size_t off, len;
+  } seg[OUTBUF_MAXSEGS];
+  int nseg;
+  char inline_buf[OUTBUF_INLINE];
+} outbuf_t;
+
+void outbuf_init(outbuf_t *ob);
+void outbuf_reset(outbuf_t *ob);
+void outbuf_free(outbuf_t *ob);
+char *outbuf_reserve(outbuf_t *ob, size_t n);
+void outbuf_commit(outbuf_t *ob, size_t n);
+int outbuf_trim(outbuf_t *ob, size_t n);
+void outbuf_append(outbuf_t *ob, const void *data, size_t n);
+void outbuf_printf(outbuf_t *ob, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void outbuf_append_ref(outbuf_t *ob, const void *data, size_t n);
+size_t outbuf_size(outbuf_t *ob);
+int outbuf_write(outbuf_t *ob, int fd, int more);
+
+#endif /* __OUTBUF_H__ */
@@ -0,0 +1,408 @@
+#include <math.h>
+#include "csapp.h"
+#include "policy.h"
+
+// 캐시 교체 정책
+// 샤드는 해시 테이블과 용량만 관리하고, 어떤 객체를 남기고 버릴지는 정책이 정한다.
+// 객체는 항상 정책의 큐 하나(CachedObject.queue)에만 연결되어 있다.
+//
+// LRU:       히트하면 맨 앞으로, 맨 뒤부터 제거. 한 번만 쓰이는 URL이 쏟아지면 작업 집합이 통째로 밀려난다.
+// W-TinyLFU: 작은 LRU window(1%) 뒤에 SLRU(probation 20% / protected 80%)를 두고,
+//            window에서 밀려난 후보와 main의 제거 대상 중 count-min sketch로 추정한 접근 빈도가 높은 쪽만 남긴다.
+// S3-FIFO:   새 객체는 small FIFO(10%)로 들어가 그동안 한 번이라도 다시 쓰이면 main FIFO로 옮겨지고,
+//            아니면 바로 쫓겨나 키만 ghost에 남는다. ghost에 있던 키는 다음에 바로 main으로 들어간다.
+//            main은 접근 비트(freq, 최대 3)가 남아 있으면 하나 줄이고 다시 넣는 FIFO-reinsertion.
+// GDSF:      Greedy-Dual-Size-Frequency. priority = L + freq / size^w 가 가장 낮은 객체부터 제거하고
+//            L을 그 값으로 올린다 (최소 힙). 큰 객체 하나가 작은 인기 객체 여럿을 밀어내지 못한다.
+//            w = 1이면 객체 적중률, w = 0이면 바이트 적중률(크기 무시, 빈도 + aging)에 유리하다.
+
+#define OBJ_SIZE(o) ((long)(o)->reserved) // 캐시 용량과 같은 기준 (슬랩에서 잡힌 바이트)
+
+enum { Q_WINDOW = 0, Q_PROBATION = 1, Q_PROTECTED = 2 }; // W-TinyLFU
+enum { Q_SMALL = 0, Q_MAIN = 1 };                        // S3-FIFO
+
+#define FREQ_MAX 3 // S3-FIFO 접근 횟수 상한 (2비트)
+
+
+// 큐 맨 앞(head)에 연결
+static void q_push(cache_policy_t *p, int qi, CachedObject *obj)
+{
+  policy_queue_t *q = &p->q[qi];
+
+  obj->queue = qi;
+  obj->prev = NULL;
+  obj->next = q->head;
+  if (q->head)
+    q->head->prev = obj;
+  else
+    q->tail = obj;
+  q->head = obj;
+  q->bytes += OBJ_SIZE(obj);
+}
+
+// 자신이 속한 큐에서 분리
+static void q_unlink(cache_policy_t *p, CachedObject *obj)
+{
+  policy_queue_t *q = &p->q[obj->queue];
+
+  if (obj->prev)
+    obj->prev->next = obj->next;
+  else
+    q->head = obj->next;
+  if (obj->next)
+    obj->next->prev = obj->prev;
+  else
+    q->tail = obj->prev;
+  obj->prev = obj->next = NULL;
+  q->bytes -= OBJ_SIZE(obj);
+}
+
+// 다른(또는 같은) 큐의 맨 앞으로 이동
+static void q_move(cache_policy_t *p, int qi, CachedObject *obj)
+{
+  q_unlink(p, obj);
+  q_push(p, qi, obj);
+}
+
+static void common_remove(cache_policy_t *p, CachedObject *obj)
+{
+  q_unlink(p, obj);
+}
+
+
+// ---------- LRU ----------
+
+static void lru_insert(cache_policy_t *p, CachedObject *obj, CachedObject *old)
+{
+  q_push(p, 0, obj);
+}
+
+static void lru_access(cache_policy_t *p, CachedObject *obj)
+{
+  if (obj != p->q[0].head) // 이미 가장 앞에 있으면 그대로
+    q_move(p, 0, obj);
+}
+
+static CachedObject *lru_victim(cache_policy_t *p)
+{
+  return p->q[0].tail;
+}
+
+const policy_ops_t policy_lru = {"lru", lru_insert, lru_access, common_remove, lru_victim};
+
+
+// ---------- W-TinyLFU ----------
+
+// 행마다 다른 곱셈 상수로 키 해시를 섞어 카운터 위치를 고름
+static const uint64_t sketch_seed[SKETCH_DEPTH] = {
+    0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL, 0x165667b19e3779f9ULL, 0xd6e8feb86659fd93ULL};
+
+static inline size_t sketch_index(uint64_t hash, int row)
+{
+  return ((hash * sketch_seed[row]) >> 32) & (SKETCH_WIDTH - 1);
+}
+
+// 접근 한 번 기록. 표본이 카운터 수의 10배가 되면 모든 카운터를 절반으로 (오래된 인기도가 사라지게)
+static void sketch_add(cache_policy_t *p, uint64_t hash)
+{
+  for (int r = 0; r < SKETCH_DEPTH; r++)
+  {
+    uint8_t *c = &p->sketch[r][sketch_index(hash, r)];
+    if (*c < 15)
+      (*c)++;
+  }
+  if (++p->samples >= 10 * SKETCH_WIDTH)
+  {
+    for (int r = 0; r < SKETCH_DEPTH; r++)
+      for (int i = 0; i < SKETCH_WIDTH; i++)
+        p->sketch[r][i] >>= 1;
+    p->samples /= 2;
+  }
+}
+
+// 추정 빈도 = 행들 중 최솟값 (다른 키와 겹친 만큼 과대 추정만 가능)
+static int sketch_estimate(cache_policy_t *p, uint64_t hash)
+{
+  int f = 15;
+
+  for (int r = 0; r < SKETCH_DEPTH; r++)
+  {
+    int c = p->sketch[r][sketch_index(hash, r)];
+    if (c < f)
+      f = c;
+  }
+  return f;
+}
+
+static long window_cap(cache_policy_t *p)
+{
+  return p->capacity / 100;
+}
+
+// protected가 80%를 넘으면 오래된 것부터 probation으로 내림
+static void tinylfu_demote(cache_policy_t *p)
+{
+  long protected_cap = (p->capacity - window_cap(p)) * 8 / 10;
+
+  while (p->q[Q_PROTECTED].bytes > protected_cap && p->q[Q_PROTECTED].tail)
+    q_move(p, Q_PROBATION, p->q[Q_PROTECTED].tail);
+}
+
+// 새 객체는 window로. 같은 키를 갱신하는 경우엔 main에서의 자리를 이어받는다
+static void tinylfu_insert(cache_policy_t *p, CachedObject *obj, CachedObject *old)
+{
+  sketch_add(p, obj->hash);
+  q_push(p, old ? old->queue : Q_WINDOW, obj);
+}
+
+static void tinylfu_access(cache_policy_t *p, CachedObject *obj)
+{
+  sketch_add(p, obj->hash);
+  if (obj->queue == Q_PROBATION)
+  {
+    q_move(p, Q_PROTECTED, obj); // 두 번째 접근: 보호 구역으로 승격
+    tinylfu_demote(p);
+  }
+  else if (obj != p->q[obj->queue].head)
+    q_move(p, obj->queue, obj);
+}
+
+// window가 넘치면 window의 가장 오래된 객체(후보)를 main으로 보내려 한다.
+// main에 자리가 없으면 main의 제거 대상과 빈도를 비교해 후보가 더 자주 쓰였을 때만 받아들인다 (TinyLFU admission).
+static CachedObject *tinylfu_victim(cache_policy_t *p)
+{
+  CachedObject *cand, *vict;
+
+  while ((cand = p->q[Q_WINDOW].tail) && p->q[Q_WINDOW].bytes > window_cap(p))
+  {
+    vict = p->q[Q_PROBATION].tail ? p->q[Q_PROBATION].tail : p->q[Q_PROTECTED].tail;
+    if (!vict || p->q[Q_PROBATION].bytes + p->q[Q_PROTECTED].bytes + OBJ_SIZE(cand) <= p->capacity - window_cap(p))
+    {
+      q_move(p, Q_PROBATION, cand); // main에 빈자리가 있으면 그대로 입장
+      continue;
+    }
+    return sketch_estimate(p, cand->hash) > sketch_estimate(p, vict->hash) ? vict : cand;
+  }
+
+  // window는 여유가 있는데 전체가 넘친 경우: main에서 제거
+  if (p->q[Q_PROBATION].tail)
+    return p->q[Q_PROBATION].tail;
+  if (p->q[Q_PROTECTED].tail)
+    return p->q[Q_PROTECTED].tail;
+  return p->q[Q_WINDOW].tail;
+}
+
+const policy_ops_t policy_tinylfu = {"tinylfu", tinylfu_insert, tinylfu_access, common_remove, tinylfu_victim};
+
+
+// ---------- S3-FIFO ----------
+
+// ghost는 해시 하위 비트로 칸을 정하는 직접 사상 테이블 (O(1), 같은 칸이면 새 키가 옛 키를 밀어냄)
+// ghost에 있던 키면 지우고 1
+static int ghost_take(cache_policy_t *p, uint64_t hash)
+{
+  uint64_t *slot = &p->ghost[hash & (GHOST_ENTRIES - 1)];
+
+  if (*slot != hash)
+    return 0;
+  *slot = 0;
+  return 1;
+}
+
+static void ghost_add(cache_policy_t *p, uint64_t hash)
+{
+  p->ghost[hash & (GHOST_ENTRIES - 1)] = hash;
+}
+
+// 새 객체는 small로, 최근에 small에서 쫓겨났던 키(ghost)나 갱신되는 main 객체는 main으로
+static void s3fifo_insert(cache_policy_t *p, CachedObject *obj, CachedObject *old)
+{
+  int qi = Q_SMALL;
+
+  if (old)
+  {
+    qi = old->queue;
+    obj->freq = old->freq;
+  }
+  else if (ghost_take(p, obj->hash))
+    qi = Q_MAIN;
+  q_push(p, qi, obj);
+}
+
+// 히트는 접근 횟수만 올린다 (리스트를 건드리지 않음)
+static void s3fifo_access(cache_policy_t *p, CachedObject *obj)
+{
+  if (obj->freq < FREQ_MAX)
+    obj->freq++;
+}
+
+static CachedObject *s3fifo_victim(cache_policy_t *p)
+{
+  CachedObject *t;
+
+  while (1)
+  {
+    // small이 10%를 넘으면 small에서 (객체가 하나뿐이면 방금 들어온 것이므로 main에서)
+    t = p->q[Q_SMALL].tail;
+    if (t && (p->q[Q_SMALL].bytes > p->capacity / 10 || !p->q[Q_MAIN].tail) &&
+        (t != p->q[Q_SMALL].head || !p->q[Q_MAIN].tail))
+    {
+      if (t->freq == 0)
+      {
+        ghost_add(p, t->hash); // 한 번도 다시 안 쓰임: 키만 기억하고 제거
+        return t;
+      }
+      t->freq = 0;
+      q_move(p, Q_MAIN, t);
+      continue;
+    }
+
+    if (!(t = p->q[Q_MAIN].tail))
+      return NULL;
+    if (t->freq == 0)
+      return t;
+    t->freq--;
+    q_move(p, Q_MAIN, t);
+  }
+}
+
+const policy_ops_t policy_s3fifo = {"s3fifo", s3fifo_insert, s3fifo_access, common_remove, s3fifo_victim};
+
+
+// ---------- GDSF ----------
+
+static double gdsf_weight = 1.0; // --gdsf-size-weight (0..1)
+
+void policy_set_gdsf_weight(double weight)
+{
+  gdsf_weight = weight;
+}
+
+static void heap_set(cache_policy_t *p, int i, CachedObject *obj)
+{
+  p->heap[i] = obj;
+  obj->heap_pos = i;
+}
+
+// i의 객체를 부모보다 작으면 위로, 자식보다 크면 아래로 옮겨 힙 순서를 회복
+static void heap_fix(cache_policy_t *p, int i)
+{
+  CachedObject *obj = p->heap[i];
+  int c;
+
+  while (i > 0 && p->heap[(i - 1) / 2]->priority > obj->priority)
+  {
+    heap_set(p, i, p->heap[(i - 1) / 2]);
+    i = (i - 1) / 2;
+  }
+  while ((c = 2 * i + 1) < p->heap_len)
+  {
+    if (c + 1 < p->heap_len && p->heap[c + 1]->priority < p->heap[c]->priority)
+      c++;
+    if (p->heap[c]->priority >= obj->priority)
+      break;
+    heap_set(p, i, p->heap[c]);
+    i = c;
+  }
+  heap_set(p, i, obj);
+}
+
+static void gdsf_prioritize(cache_policy_t *p, CachedObject *obj)
+{
+  obj->priority = p->inflation + obj->freq / pow((double)OBJ_SIZE(obj) + 1, gdsf_weight);
+}
+
+static void gdsf_insert(cache_policy_t *p, CachedObject *obj, CachedObject *old)
+{
+  if (p->heap_len == p->heap_cap)
+  {
+    p->heap_cap = p->heap_cap ? p->heap_cap * 2 : 64;
+    p->heap = Realloc(p->heap, p->heap_cap * sizeof(CachedObject *));
+  }
+  obj->freq = old ? old->freq : 1;
+  gdsf_prioritize(p, obj);
+  heap_set(p, p->heap_len++, obj);
+  heap_fix(p, obj->heap_pos);
+}
+
+static void gdsf_access(cache_policy_t *p, CachedObject *obj)
+{
+  obj->freq++;
+  gdsf_prioritize(p, obj);
+  heap_fix(p, obj->heap_pos);
+}
+
+static void gdsf_remove(cache_policy_t *p, CachedObject *obj)
+{
+  CachedObject *last = p->heap[--p->heap_len];
+
+  if (last != obj)
+  {
+    heap_set(p, obj->heap_pos, last);
+    heap_fix(p, last->heap_pos);
+  }
+}
+
+// 가장 낮은 priority가 제거 대상, 그 값이 새 L
+static CachedObject *gdsf_victim(cache_policy_t *p)
+{
+  if (!p->heap_len)
+    return NULL;
+  p->inflation = p->heap[0]->priority;
+  return p->heap[0];
+}
+
+const policy_ops_t policy_gdsf = {"gdsf", gdsf_insert, gdsf_access, gdsf_remove, gdsf_victim};
+
+
+// GDSF 힙을 priority 오름차순으로 정렬할 때 비교
+static int priority_cmp(const void *a, const void *b)
+{
+  double pa = (*(CachedObject *const *)a)->priority, pb = (*(CachedObject *const *)b)->priority;
+
+  return pa < pb ? -1 : pa > pb;
+}
+
+// 정책이 가진 객체를 먼저 제거될 것부터 out에 채우고 개수 반환 (out은 샤드 객체 수만큼)
+// 큐 정책은 큐 번호 순으로 각 큐의 tail부터 head까지 (W-TinyLFU: window → probation → protected, S3-FIFO: small → main),
+// GDSF는 priority가 낮은 것부터. 이 순서대로 다시 insert하면 큐 순서가 재현된다 (스냅샷, snapshot.c)
+int policy_order(cache_policy_t *p, CachedObject **out)
+{
+  int n = 0;
+
+  if (p->ops == &policy_gdsf)
+  {
+    memcpy(out, p->heap, p->heap_len * sizeof(CachedObject *));
+    qsort(out, p->heap_len, sizeof(CachedObject *), priority_cmp);
+    return p->heap_len;
+  }
+  for (int qi = 0; qi < POLICY_QUEUES; qi++)
+    for (CachedObject *obj = p->q[qi].tail; obj; obj = obj->prev)
+      out[n++] = obj;
+  return n;
+}
+
+// 이름으로 정책 찾기, 없으면 NULL
+const policy_ops_t *policy_find(const char *name)
+{
+  static const policy_ops_t *all[] = {&policy_lru, &policy_tinylfu, &policy_s3fifo, &policy_gdsf};
+
+  for (size_t i = 0; i < sizeof(all) / sizeof(all[0]); i++)
+    if (!strcmp(all[i]->name, name))
+      return all[i];
+  return NULL;
+}
+
+void policy_init(cache_policy_t *p, const policy_ops_t *ops, long capacity)
+{
+  memset(p, 0, sizeof(*p));
+  p->ops = ops;
+  p->capacity = capacity;
+}
+
+// 정책이 따로 할당한 메모리 해제 (큐는 비어 있어야 함)
+void policy_free(cache_policy_t *p)
+{
+  free(p->heap);
+  p->heap = NULL;
+}
@@ -0,0 +1,55 @@
+//webproxy-lab/sweeetpotatooo/policy.h
+#ifndef __POLICY_H__
+#define __POLICY_H__
+
+#include <stdint.h>
+
+#include "cache.h"
+
+#define POLICY_QUEUES 3        // 정책 하나가 쓰는 최대 큐 수
+#define SKETCH_DEPTH 4         // count-min sketch 행 수 (W-TinyLFU)
+#define SKETCH_WIDTH 1024      // 행마다 카운터 수 (2의 거듭제곱)
+#define GHOST_ENTRIES 256      // S3-FIFO ghost에 기억하는 키 해시 수 (2의 거듭제곱)
+
+// 정책이 관리하는 큐 하나 (객체에 내장된 prev/next로 연결, head가 가장 최근)
+typedef struct
+{
+  CachedObject *head, *tail;
+  long bytes;
+} policy_queue_t;
+
+typedef struct cache_policy cache_policy_t;
+
+// 교체 정책 연산. 모두 샤드 락을 잡은 상태에서 호출된다.
+typedef struct
+{
+  const char *name;
+  void (*insert)(cache_policy_t *p, CachedObject *obj, CachedObject *old); // 새 객체 (old: 같은 키로 교체되는 객체, 없으면 NULL)
+  void (*access)(cache_policy_t *p, CachedObject *obj);                     // 히트
+  void (*remove)(cache_policy_t *p, CachedObject *obj);                     // 큐에서 분리 (제거 직전)
+  CachedObject *(*victim)(cache_policy_t *p);                               // 용량 초과 시 제거할 객체 선택 (분리는 remove가)
+} policy_ops_t;
+
+// 샤드 하나의 정책 상태
+struct cache_policy
+{
+  const policy_ops_t *ops;
+  long capacity;                              // 샤드 용량 (바이트)
+  policy_queue_t q[POLICY_QUEUES];            // LRU: [0] / W-TinyLFU: window, probation, protected / S3-FIFO: small, main
+  uint8_t sketch[SKETCH_DEPTH][SKETCH_WIDTH]; // W-TinyLFU 접근 빈도 (4비트 포화, 주기적으로 절반)
+  long samples;                               // 마지막 절반 이후 sketch에 더한 횟수
+  uint64_t ghost[GHOST_ENTRIES];              // S3-FIFO: small에서 바로 쫓겨난 키 해시 (0은 빈 칸)
+  CachedObject **heap;                        // GDSF: priority 최소 힙
+  int heap_len, heap_cap;
+  double inflation;                           // GDSF: 마지막으로 제거한 객체의 priority (L, 오래된 인기도를 밀어냄)
+};
+
+extern const policy_ops_t policy_lru, policy_tinylfu, policy_s3fifo, policy_gdsf;
+
+const policy_ops_t *policy_find(const char *name);
+void policy_init(cache_policy_t *p, const policy_ops_t *ops, long capacity);
+void policy_free(cache_policy_t *p);
+int policy_order(cache_policy_t *p, CachedObject **out);
+void policy_set_gdsf_weight(double weight);
+
+#endif /* __POLICY_H__ */
@@ -4,24 +4,90 @@
 
 #include "csapp.h"
 #include "cache.h"
-
-// 최대 캐시 크기 및 한 객체의 최대 크기
-#define MAX_CACHE_SIZE 1049000
-#define MAX_OBJECT_SIZE 102400
+#include "proxy.h"
+#include "event.h"
+#include "sbuf.h"
+#include "upstream.h"
+#include "resolver.h"
+#include "flight.h"
+#include "relay.h"
+#include "http.h"
+#include "outbuf.h"
+#include "refresh.h"
+#include "policy.h"
+#include "disk.h"
+#include "snapshot.h"
+
+#define DEFAULT_WORKERS 16  // prethread 엔진 기본 작업 스레드 수
+#define QUEUE_PER_WORKER 4  // 연결 대기열 기본 크기 = 작업 스레드 수 * 4
+#define REQ_MAXSIZE (4 * MAXBUF) // 원 서버로 보낼 요청(요청 라인 + 헤더) 최대 크기
+#define CLIENT_IDLE_TIMEOUT 5    // 클라이언트 지속 연결에서 다음 요청을 기다리는 최대 시간(초)
+#define CLIENT_MAX_REQUESTS 100  // 클라이언트 연결 하나에서 처리할 최대 요청 수
+#define REFRESH_WORKERS 2        // stale-while-revalidate 백그라운드 갱신 스레드 수
+#define REFRESH_QUEUE 64         // 갱신 대기열 크기 (가득 차면 요청 스레드가 직접 재검증)
+#define CONTENT_LENGTH_ROOM 40   // 길이를 모르던 바디의 캐시 사본에 붙일 "Content-length: N\r\n" 줄의 최대 길이
+
+// 동시성 엔진 종류
+typedef enum
+{
+  ENGINE_THREAD,    // 연결마다 스레드 생성
+  ENGINE_PRETHREAD, // 미리 만든 작업 스레드 + 유한 연결 대기열
+  ENGINE_EPOLL      // epoll 이벤트 루프
+} engine_t;
 
 // 함수 선언
 void *thread(void *vargp);  // 스레드 함수
-void doit(int clientfd);    // 요청을 처리 메인 함수
-void read_requesthdrs(rio_t *rp, void *buf, int serverfd, char *hostname, char *port); // 요청 헤더 처리
-void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg);    // 에러 응답 생성
-void parse_uri(char *uri, char *hostname, char *port, char *path);                     // URI 파싱
+void *worker(void *vargp);  // prethread 작업 스레드 함수
+void handle_client(int clientfd); // 연결 하나에서 요청들을 처리 후 종료
+int doit(int clientfd, rio_t *rp, int may_keep_alive); // 요청을 처리 메인 함수, 연결을 계속 쓸 수 있으면 1
+static int respond(int clientfd, outbuf_t *req, char *method, char *hostname, char *port, char *path, int client_keep_alive,
+                   int conditional); // 헤더까지 읽은 요청에 응답
+static void refresh_entry(refresh_job_t *job); // 백그라운드 갱신 작업
+int read_requesthdrs(rio_t *rp, outbuf_t *req, char *hostname, char *port, int *client_keep_alive, int *conditional); // 요청 헤더 처리
+void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg);    // 에러 응답 전송
 
 // 고정된 User-Agent 헤더 (프록시가 이 값을 사용)
 static const int is_local_test = 1;
-static const char *user_agent_hdr =
+const char *user_agent_hdr =
     "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:10.0.3) Gecko/20120305 Firefox/10.0.3\r\n";
 
-pthread_rwlock_t cache_lock;
+sbuf_t sbuf; // prethread 엔진의 연결 대기열
+static char *snapshot_path; // --snapshot (NULL이면 스냅샷 없음)
+
+// 실행 옵션 안내 후 종료
+static void usage(char *prog)
+{
+  fprintf(stderr, "usage: %s <port> [--engine=thread|prethread|epoll] [--threads=N] [--queue=N] [--cache-policy=P] [--gdsf-size-weight=W]\n"
+                  "       [--disk-cache=DIR] [--disk-size-mb=N] [--disk-max-object-kb=N] [--snapshot=FILE]\n", prog);
+  fprintf(stderr, "  --threads: prethread 작업 스레드 수 (기본 %d) / epoll 루프 스레드 수 (기본 코어 수)\n", DEFAULT_WORKERS);
+  fprintf(stderr, "  --queue:   prethread 연결 대기열 크기 (기본 threads * %d)\n", QUEUE_PER_WORKER);
+  fprintf(stderr, "  --cache-policy: 캐시 교체 정책 lru|tinylfu|s3fifo|gdsf (기본 lru)\n");
+  fprintf(stderr, "  --gdsf-size-weight: gdsf에서 크기 가중치 0..1 (1: 객체 적중률, 0: 바이트 적중률 우선, 기본 1)\n");
+  fprintf(stderr, "  --disk-cache: 메모리 캐시 아래 디스크 계층을 둘 디렉터리 (재시작해도 유지, 기본 끔)\n");
+  fprintf(stderr, "  --disk-size-mb: 디스크 계층 로그 크기 (기본 %d)\n", DISK_DEFAULT_SIZE_MB);
+  fprintf(stderr, "  --disk-max-object-kb: 디스크에 둘 최대 바디 크기 (기본 %d)\n", DISK_DEFAULT_MAX_OBJECT_KB);
+  fprintf(stderr, "  --snapshot: SIGUSR1/SIGTERM에 메모리 캐시를 덤프하고 시작할 때 다시 읽을 파일 (기본 끔)\n");
+  exit(1);
+}
+
+// SIGUSR1: 메모리 캐시를 스냅샷으로 덤프하고 계속 실행, SIGTERM: 덤프 후 종료
+static void *snapshot_thread(void *vargp)
+{
+  sigset_t *set = vargp;
+  int sig;
+
+  Pthread_detach(pthread_self());
+  while (sigwait(set, &sig) == 0)
+  {
+    if (snapshot_save(snapshot_path) < 0)
+      fprintf(stderr, "snapshot: failed to write %s: %s\n", snapshot_path, strerror(errno));
+    else
+      printf("snapshot: saved %s\n", snapshot_path);
+    if (sig == SIGTERM)
+      exit(0);
+  }
+  return NULL;
+}
 
 int main(int argc, char **argv)
 {
@@ -30,22 +96,99 @@ int main(int argc, char **argv)
   socklen_t clientlen;                                  // 주소 길이
   struct sockaddr_storage clientaddr;                   // 클라이언트 주소 정보 구조체
   pthread_t tid;                                        // 스레드 ID
+  engine_t engine = ENGINE_THREAD;                      // --engine
+  int nthreads = 0;                                     // --threads (0이면 엔진별 기본값)
+  int queue_size = 0;                                   // --queue (0이면 nthreads * QUEUE_PER_WORKER)
+  char *disk_dir = NULL;                                // --disk-cache (NULL이면 디스크 계층 없음)
+  long disk_size_mb = DISK_DEFAULT_SIZE_MB;             // --disk-size-mb
+  long disk_max_kb = DISK_DEFAULT_MAX_OBJECT_KB;        // --disk-max-object-kb
 
   signal(SIGPIPE, SIG_IGN); // 클라이언트 종료 시 SIGPIPE 무시 (서버 죽지 않게)
 
-  // 캐시 리스트 초기화 (전역)
-  rootp = (CachedObject *)calloc(1, sizeof(CachedObject)); // 캐시 맨 앞
-  lastp = (CachedObject *)calloc(1, sizeof(CachedObject)); // 캐시 맨 뒤
+  // 캐시 샤드 락 초기화 (모든 스레드가 공유하므로 한 번만)
+  cache_init();
 
   //실행파일 + 포트번호 없으면 에러
-  if (argc != 2) {
-    fprintf(stderr, "usage: %s <port>\n", argv[0]);
-    exit(1);
+  if (argc < 2)
+    usage(argv[0]);
+
+  // 나머지 인자: 엔진 선택 옵션
+  for (int i = 2; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--engine=epoll"))
+      engine = ENGINE_EPOLL;
+    else if (!strcmp(argv[i], "--engine=prethread"))
+      engine = ENGINE_PRETHREAD;
+    else if (!strcmp(argv[i], "--engine=thread"))
+      engine = ENGINE_THREAD;
+    else if (!strncmp(argv[i], "--threads=", 10) && atoi(argv[i] + 10) > 0)
+      nthreads = atoi(argv[i] + 10);
+    else if (!strncmp(argv[i], "--queue=", 8) && atoi(argv[i] + 8) > 0)
+      queue_size = atoi(argv[i] + 8);
+    else if (!strncmp(argv[i], "--cache-policy=", 15) && cache_set_policy(argv[i] + 15) == 0)
+      ;
+    else if (!strncmp(argv[i], "--gdsf-size-weight=", 19) && atof(argv[i] + 19) >= 0 && atof(argv[i] + 19) <= 1)
+      policy_set_gdsf_weight(atof(argv[i] + 19));
+    else if (!strncmp(argv[i], "--disk-cache=", 13) && argv[i][13])
+      disk_dir = argv[i] + 13;
+    else if (!strncmp(argv[i], "--disk-size-mb=", 15) && atol(argv[i] + 15) > 0)
+      disk_size_mb = atol(argv[i] + 15);
+    else if (!strncmp(argv[i], "--disk-max-object-kb=", 21) && atol(argv[i] + 21) > 0)
+      disk_max_kb = atol(argv[i] + 21);
+    else if (!strncmp(argv[i], "--snapshot=", 11) && argv[i][11])
+      snapshot_path = argv[i] + 11;
+    else
+      usage(argv[0]);
+  }
+
+  // 디스크 계층: 이전 실행이 남긴 로그와 인덱스를 그대로 이어 씀 (로그 하나의 1/4보다 큰 최대 객체 크기는 거절)
+  if (disk_dir && disk_open(disk_dir, disk_size_mb * 1024 * 1024, disk_max_kb * 1024) < 0)
+    app_error("disk cache: cannot open directory or object limit too large for the log size");
+
+  // 스냅샷: 스레드를 만들기 전에 SIGUSR1/SIGTERM을 막아 두면 모든 스레드가 물려받고, 전용 스레드만 sigwait로 받는다
+  // 이전 스냅샷은 mmap해 헤더만 확인하고 바로 시작 (기록은 미스 때와 백그라운드에서 올림)
+  if (snapshot_path)
+  {
+    sigset_t *set = Malloc(sizeof(sigset_t));
+
+    sigemptyset(set);
+    sigaddset(set, SIGUSR1);
+    sigaddset(set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, set, NULL);
+    if (snapshot_open(snapshot_path) == 0)
+      printf("snapshot: loading %s in the background\n", snapshot_path);
+    Pthread_create(&tid, NULL, snapshot_thread, set);
   }
+  refresh_init(REFRESH_WORKERS, REFRESH_QUEUE, refresh_entry);
 
   // 프록시 서버 리스닝 소켓 열기 => socket() -> bind( ) -> listen()
   listenfd = Open_listenfd(argv[1]);
 
+  // epoll 엔진: 소수의 이벤트 루프 스레드가 모든 연결을 처리 (반환하지 않음)
+  if (engine == ENGINE_EPOLL)
+  {
+    if (!nthreads)
+      nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    run_event_loops(listenfd, nthreads > 0 ? nthreads : 1);
+  }
+
+  // prethread 엔진: 작업 스레드를 미리 만들고, 메인 스레드는 accept한 fd를 대기열에 넣기만 함
+  // 대기열이 가득 차면 sbuf_insert에서 막혀 accept를 멈춘다 (back-pressure)
+  if (engine == ENGINE_PRETHREAD)
+  {
+    if (!nthreads)
+      nthreads = DEFAULT_WORKERS;
+    sbuf_init(&sbuf, queue_size ? queue_size : nthreads * QUEUE_PER_WORKER);
+    for (int i = 0; i < nthreads; i++)
+      Pthread_create(&tid, NULL, worker, NULL);
+
+    while (1)
+    {
+      clientlen = sizeof(clientaddr);
+      sbuf_insert(&sbuf, Accept(listenfd, (SA *)&clientaddr, &clientlen));
+    }
+  }
+
   // while (1) {
   //   1. 누가 접속하면 -> 그 연결을 accept
   //   2. 그 연결 정보를 담은 소켓을 메모리에 동적 할당
@@ -77,224 +220,700 @@ void *thread(void *vargp)
   int clientfd = *((int *)vargp);       // 전달받은 client 소켓
   Pthread_detach(pthread_self());       // 스레드 종료 시 자원 자동 회수
   Free(vargp);                          // 힙에 할당한 clientfd 포인터 해제
-  doit(clientfd);                       // 요청 처리
-  Close(clientfd);                      // 클라이언트 연결 종료
+  handle_client(clientfd);              // 요청 처리 후 연결 종료
   return NULL;
 }
 
-// 한 줄의 헤더를 받아서 Proxy가 요구하는 형식에 맞게 수정하거나 그대로 전달
-int handle_header_line(char *line, char *write_buf, int *host, int *conn, int *proxy_conn, int *user_agent) {
-  
-  // Proxy-Connection 헤더 발견 → 무조건 close로 고정
-  if (strstr(line, "Proxy-Connection")) {
-    sprintf(write_buf, "Proxy-Connection: close\r\n");
-    *proxy_conn = 1;  // 존재 표시
-  }
+// prethread 작업 스레드 함수: 대기열에서 연결을 하나씩 꺼내 처리
+void *worker(void *vargp)
+{
+  Pthread_detach(pthread_self());
+  while (1)
+    handle_client(sbuf_remove(&sbuf));
+  return NULL;
+}
 
-  // Connection 헤더 발견 → close로 고정
-  else if (strstr(line, "Connection")) {
-    sprintf(write_buf, "Connection: close\r\n");
-    *conn = 1;
-  }
+// 클라이언트 연결 하나 처리 (모든 스레드 기반 엔진이 공유)
+// 지속 연결이면 같은 rio로 다음 요청을 이어서 읽으므로, 파이프라인된 요청도 도착 순서대로 처리된다.
+// 요청 사이에 CLIENT_IDLE_TIMEOUT초 동안 아무것도 오지 않거나 CLIENT_MAX_REQUESTS개를 처리하면 닫는다.
+void handle_client(int clientfd)
+{
+  rio_t request_rio;
+  struct timeval idle = {CLIENT_IDLE_TIMEOUT, 0};
+  int nreq = 1;
+
+  Setsockopt(clientfd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle)); // 대기 중인 read가 타임아웃되게
+  Rio_readinitb(&request_rio, clientfd);
+  while (doit(clientfd, &request_rio, nreq < CLIENT_MAX_REQUESTS))    // 요청 처리
+    nreq++;
+  Close(clientfd);                      // 클라이언트 연결 종료
+}
 
-  // User-Agent 헤더 발견 → 고정된 문자열로 교체
-  else if (strstr(line, "User-Agent")) {
-    sprintf(write_buf, "%s", user_agent_hdr);
-    *user_agent = 1;
+// 클라이언트가 보낸 요청 헤더를 읽고, 원 서버로 보낼 형태(keep-alive)로 정리해서 req 뒤에 이어 붙임
+// 각 줄은 rio 버퍼 안에서 바로 파싱해(rio_peeklineb) 출력 버퍼로 한 번만 복사한다
+// 클라이언트의 Connection/Proxy-Connection 값은 *client_keep_alive에 반영 (기본값은 호출자가 HTTP 버전으로 정함)
+// 클라이언트가 직접 조건부 요청(If-None-Match/If-Modified-Since)을 보냈으면 *conditional = 1
+// 성공하면 0, 클라이언트가 헤더 도중 연결을 끊거나 요청이 REQ_MAXSIZE를 넘으면 -1
+int read_requesthdrs(rio_t *request_rio, outbuf_t *req, char *hostname, char *port, int *client_keep_alive, int *conditional)
+{
+  http_rewrite_t rw;
+  http_header_t h;
+  char *line;
+  int n, rc;
+  int ua_len = strlen(user_agent_hdr); // 다시 쓴 줄은 원래 줄보다 최대 이만큼 길어짐 (User-Agent 교체)
+
+  http_rewrite_init(&rw, *client_keep_alive);
+
+  // 빈 줄 전까지 반복해서 헤더 읽기 (첫 번째 줄은 doit() 함수에서 이미 읽음)
+  while (1) {
+    if ((n = rio_peeklineb(request_rio, &line)) <= 0 || line[n - 1] != '\n') // 끊겼거나 rio 버퍼보다 긴 줄
+      return -1;
+    if ((rc = http_parse_header(line, n, &h)) == 0)
+      break;
+    if (rc < 0)
+      return -1;
+
+    if (req->len + n > REQ_MAXSIZE)
+      return -1;
+    outbuf_commit(req, http_rewrite_header(&rw, &h, line, n, outbuf_reserve(req, n + ua_len), 1));
   }
 
-  // Host 헤더 발견 → 수정하지 않고 그대로 전달
-  else if (strstr(line, "Host")) {
-    *host = 1;
-    strcpy(write_buf, line);
+  // 누락된 필수 헤더가 있으면 보충 (Host, User-Agent, Connection 줄과 빈 줄이 들어갈 자리)
+  *client_keep_alive = rw.client_keep_alive;
+  *conditional = (rw.seen & ((1 << HDR_IF_NONE_MATCH) | (1 << HDR_IF_MODIFIED_SINCE))) != 0;
+  n = strlen(hostname) + strlen(port) + ua_len + 64;
+  outbuf_commit(req, http_rewrite_finish(&rw, outbuf_reserve(req, n), 1, hostname, port));
+  return 0;
+}
+
+// 에러 응답(헤더 + 바디)을 buf(CLIENTERROR_BUFSIZE 이상)에 작성하고 길이 반환
+// cause는 클라이언트가 보낸 URI나 요청 줄일 수 있으므로 앞 CLIENTERROR_CAUSE_MAX바이트만 보여 준다
+int format_clienterror(char *buf, char *cause, char *errnum, char *shortmsg, char *longmsg)
+{
+  char body[MAXBUF];
+  int len;
+
+  // 에러 Body 생성
+  len = snprintf(body, sizeof(body),
+                 "<html><title>Tiny Error</title><body bgcolor="
+                 "ffffff"
+                 ">\r\n%s: %s\r\n<p>%s: %.*s\r\n<hr><em>The Tiny Web server</em>\r\n",
+                 errnum, shortmsg, longmsg, CLIENTERROR_CAUSE_MAX, cause);
+  if (len >= (int)sizeof(body))
+    len = sizeof(body) - 1;
+
+  // 에러 Header + Body
+  len = snprintf(buf, CLIENTERROR_BUFSIZE, "HTTP/1.0 %.32s %.64s\r\nContent-type: text/html\r\nContent-length: %d\r\n\r\n%s",
+                 errnum, shortmsg, len, body);
+  return len < CLIENTERROR_BUFSIZE ? len : CLIENTERROR_BUFSIZE - 1;
+}
+
+void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg)
+{
+  char buf[CLIENTERROR_BUFSIZE];
+  int len = format_clienterror(buf, cause, errnum, shortmsg, longmsg);
+
+  // 에러 Header & Body를 write 한 번으로 전송 (클라이언트가 끊었어도 프로세스는 계속)
+  rio_writen(fd, buf, len);
+}
+
+
+// 원 서버 응답의 상태 라인과 헤더를 읽어 클라이언트로 보낼 헤더 블록을 hdrs에 이어 붙임 (빈 줄 제외)
+// hop-by-hop 헤더(Connection, Keep-Alive, Proxy-Connection)는 제거한다. Connection은 호출자가 붙인다.
+// chunked 응답은 프록시가 디코딩해 보내므로(캐시 사본에는 Content-length를 붙임) Transfer-Encoding도 제거한다.
+// Age도 빼서 *age로 돌려준다 (캐시가 저장 후 흐른 시간을 더해 보낼 때 다시 붙임)
+// 성공하면 0, 응답이 잘못됐거나 헤더가 MAXBUF를 넘거나 연결이 끊기면 -1
+static int read_response_headers(rio_t *rp, outbuf_t *hdrs, int *status, long *content_length, int *chunked, int *keep_alive,
+                                 long *age)
+{
+  char line[MAXLINE];
+  int major = 0, minor = 0, n, rc;
+  http_header_t h;
+
+  if ((n = rio_readlineb(rp, line, MAXLINE)) <= 0 || sscanf(line, "HTTP/%d.%d %d", &major, &minor, status) != 3)
+    return -1;
+  outbuf_append(hdrs, line, n);
+
+  *content_length = -1;
+  *chunked = 0;
+  *age = 0;
+  *keep_alive = (major == 1 && minor >= 1); // HTTP/1.1은 기본이 지속 연결
+
+  while (1)
+  {
+    if ((n = rio_readlineb(rp, line, MAXLINE)) <= 0 || (rc = http_parse_header(line, n, &h)) < 0)
+      return -1;
+    if (rc == 0)
+      break;
+
+    switch (h.id)
+    {
+    case HDR_CONTENT_LENGTH:
+      *content_length = atol(h.value.p);
+      break;
+    case HDR_TRANSFER_ENCODING:
+      *chunked = http_value_has(&h.value, "chunked");
+      continue;
+    case HDR_CONNECTION:
+      if (http_value_has(&h.value, "close"))
+        *keep_alive = 0;
+      else if (http_value_has(&h.value, "keep-alive"))
+        *keep_alive = 1;
+      continue;
+    case HDR_AGE:
+      *age = atol(h.value.p);
+      continue;
+    case HDR_KEEP_ALIVE:
+    case HDR_PROXY_CONNECTION:
+      continue;
+    }
+
+    if (hdrs->len + n > MAXBUF)
+      return -1;
+    outbuf_append(hdrs, line, n);
   }
+  return 0;
+}
+
+// 미스 응답 바디를 받는 동안의 상태: 받은 바이트를 바로 클라이언트에게 흘려보내면서 캐시에 넣을 사본을 모은다
+typedef struct
+{
+  int clientfd;
+  int sending;         // 클라이언트 전송이 아직 실패하지 않았으면 1 (실패하면 이후로는 보내지 않음)
+  char *copy;          // 캐시 사본: 앞 head바이트는 헤더 블록 자리, 그 뒤에 바디 (캐시하지 않거나 포기했으면 NULL)
+  long head, len, cap; // len: 지금까지 받은 바디 길이, cap: copy의 바디 공간
+  long max;            // 사본을 모을 최대 바디 길이 (copy_limit)
+  flight_t *flight;    // 따라 받는 follower들에게 나눠 줄 flight (없거나 포기했으면 NULL)
+} tee_t;
+
+// 미스 응답의 사본을 모을 최대 바디 길이: 메모리 캐시에 넣을 수 있는 크기, 디스크 계층이 있으면 디스크에 둘 수 있는 크기까지
+static long copy_limit(void)
+{
+  return disk_enabled() ? disk_max_object() : MAX_OBJECT_SIZE;
+}
 
-  // 그 외 일반 헤더는 그대로 전달
-  else {
-    strcpy(write_buf, line);
+// 받은 바디 n바이트를 클라이언트로 보내고 사본과 flight에 덧붙임. 사본이 t->max를 넘으면 버리고 전달만 계속한다
+// 클라이언트가 끊겨도 사본을 모으거나 follower에게 나눠 주는 중이면 끝까지 받는다 (백그라운드 갱신은 clientfd -1로 사본만 모음)
+// 보낼 곳도 모을 곳도 없어지면 -1
+static int tee_write(tee_t *t, char *p, long n)
+{
+  if (t->sending && rio_writen(t->clientfd, p, n) != n)
+    t->sending = 0;
+  if (t->copy && t->len + n > t->max)
+  {
+    free(t->copy);
+    t->copy = NULL;
+  }
+  if (t->copy)
+  {
+    if (t->len + n > t->cap)
+    {
+      while (t->len + n > t->cap)
+        t->cap *= 2;
+      t->copy = Realloc(t->copy, t->head + t->cap);
+    }
+    memcpy(t->copy + t->head + t->len, p, n);
   }
+  if (t->flight && flight_append(t->flight, p, n) < 0)
+    t->flight = NULL;
+  t->len += n;
+  return t->sending || t->copy || t->flight ? 0 : -1;
+}
+
+// rio 버퍼에 남은 데이터가 있으면 그것을, 없으면 read 한 번으로 도착한 만큼만 buf에 옮김 (최대 n바이트)
+// rio_readnb처럼 n바이트가 다 찰 때까지 기다리지 않으므로 받는 대로 전달할 수 있다. 연결 종료면 0, 에러면 -1
+static ssize_t read_some(rio_t *rp, char *buf, size_t n)
+{
+  ssize_t r;
 
-  // write_buf에 들어간 문자열 길이 반환
-  return strlen(write_buf);
+  if (rp->rio_cnt > 0)
+  {
+    r = rp->rio_cnt < (ssize_t)n ? rp->rio_cnt : (ssize_t)n;
+    memcpy(buf, rp->rio_bufptr, r);
+    rp->rio_bufptr += r;
+    rp->rio_cnt -= r;
+    return r;
+  }
+  while ((r = read(rp->rio_fd, buf, n)) < 0 && errno == EINTR)
+    ;
+  return r;
 }
-// 필수 헤더가 없을 경우 기본값으로 보충해서 서버에 전달
-void add_missing_headers(int serverfd, int host, int conn, int proxy_conn, int user_agent, char *hostname, char *port) {
-  char buf[MAXLINE];
 
-  // Proxy-Connection 헤더가 없었다면 추가
-  if (!proxy_conn) {
-    sprintf(buf, "Proxy-Connection: close\r\n");
-    Rio_writen(serverfd, buf, strlen(buf));
+// len바이트(음수면 연결 종료까지)를 받는 대로 t로 넘김. 다 받았으면 0, 잘렸거나 t가 실패하면 -1
+static int stream_span(rio_t *rp, tee_t *t, long len)
+{
+  char buf[MAXBUF];
+  ssize_t n;
+
+  while (len != 0)
+  {
+    if ((n = read_some(rp, buf, len > 0 && len < MAXBUF ? len : MAXBUF)) <= 0)
+      return n == 0 && len < 0 ? 0 : -1;
+    if (tee_write(t, buf, n) < 0)
+      return -1;
+    if (len > 0)
+      len -= n;
   }
+  return 0;
+}
+
+// 응답 바디를 받는 대로 t로 넘김
+// content_length >= 0: 그 길이만큼, chunked: 청크를 디코딩해서, 둘 다 아니면 연결 종료까지
+// 바디를 끝까지 받았으면 0, 도중에 끊기면 -1
+static int stream_body(rio_t *rp, tee_t *t, long content_length, int chunked)
+{
+  char line[MAXLINE];
+  long size;
+  ssize_t n;
 
-  // Connection 헤더가 없었다면 추가
-  if (!conn) {
-    sprintf(buf, "Connection: close\r\n");
-    Rio_writen(serverfd, buf, strlen(buf));
+  if (!chunked)
+    return stream_span(rp, t, content_length);
+
+  // chunked: "크기(16진수)\r\n" + 데이터 + "\r\n", 크기 0이면 트레일러 후 끝
+  while (1)
+  {
+    if (rio_readlineb(rp, line, MAXLINE) <= 0)
+      return -1;
+    if ((size = strtol(line, NULL, 16)) == 0)
+    {
+      while ((n = rio_readlineb(rp, line, MAXLINE)) > 0 && strcmp(line, "\r\n"))
+        ;
+      return n > 0 ? 0 : -1;
+    }
+    if (size < 0 || stream_span(rp, t, size) < 0 || rio_readlineb(rp, line, MAXLINE) <= 0)
+      return -1;
   }
+}
 
-  // Host 헤더가 없었다면 hostname, port를 사용해 추가
-  if (!host) {
-    sprintf(buf, "Host: %s:%s\r\n", hostname, port);
-    Rio_writen(serverfd, buf, strlen(buf));
+// 요청을 원 서버로 보내고 응답을 클라이언트에 전달, 캐싱 가능하면 저장
+// 풀에서 꺼낸 연결이 이미 닫혀 있었다면 새 연결로 한 번 재시도한다
+// stale이 있으면 req는 그 사본에 대한 조건부 요청이고, 304가 오면 사본의 헤더만 갱신해 캐시에서 응답한다
+// (원 서버에 닿지 못하거나 stale-if-error 기간 안에 5xx가 오면 stale로 응답)
+// clientfd가 -1이면(백그라운드 갱신) 클라이언트 쪽 전송은 모두 실패로 끝나고 캐시 저장만 일어난다
+// flight가 있으면(single-flight leader) 저장 가능한 응답의 바디를 받는 대로 flight에도 쌓아 합류한 follower들이 따라 받게 하고,
+// stored에 캐시에 저장한 객체를 참조 하나와 함께 넘겨 준다 (저장하지 않았으면 NULL 그대로)
+// 응답을 온전히 전달해 클라이언트 연결을 계속 쓸 수 있으면 1, 아니면 0
+// 요청은 write 한 번으로 보내고, 응답 바디는 모으지 않고 받는 대로 전달한다 (캐시 사본은 전달하면서 함께 모음)
+static int forward_request(int clientfd, outbuf_t *req, char *method, char *hostname, char *port, char *key,
+                           int client_keep_alive, CachedObject *stale, flight_t *flight, CachedObject **stored)
+{
+  outbuf_t resp;
+  int rc = -1, status = 0, chunked, keep_alive, reused, has_body, sent, hdrs_len, length_known;
+  long content_length, wire_len, age;
+  char *data;
+  tee_t tee;
+  CachedObject *Cache;
+  upstream_t *up = NULL;
+
+  outbuf_init(&resp);
+  for (int attempt = 0; attempt < 2 && rc < 0; attempt++)
+  {
+    if (!(up = upstream_get(hostname, port)))
+      break;
+    reused = up->reused;
+    outbuf_reset(&resp);
+    if (outbuf_write(req, up->fd, 0) == 0)
+    {
+      upstream_quickack(up);
+      rc = read_response_headers(&up->rio, &resp, &status, &content_length, &chunked, &keep_alive, &age);
+    }
+    if (rc < 0)
+    {
+      upstream_close(up);
+      up = NULL;
+      if (!reused)
+        break;
+    }
   }
+  if (rc < 0)
+  {
+    outbuf_free(&resp);
+    // 재검증하려던 원 서버에 닿지 못하면 만료된 사본으로라도 응답 (RFC 9111 4.2.4)
+    if (stale)
+      return send_cache(stale, clientfd, client_keep_alive) == 0;
+    clienterror(clientfd, hostname, "502", "Bad Gateway", "Failed to get a response from the end server");
+    return 0;
+  }
+
+  // 바디가 없는 응답: HEAD, 1xx, 204, 304 (HEAD의 Content-length는 원 서버 값을 그대로 전달)
+  has_body = strcasecmp(method, "HEAD") && status / 100 != 1 && status != 204 && status != 304;
+  if (!has_body)
+    content_length = 0, chunked = 0;
+  else if (!chunked && content_length < 0)
+    keep_alive = 0; // 연결 종료로 끝나는 바디는 재사용 불가
 
-  // User-Agent 헤더가 없었다면 고정된 문자열로 추가
-  if (!user_agent) {
-    sprintf(buf, "%s", user_agent_hdr);
-    Rio_writen(serverfd, buf, strlen(buf));
+  // 원 서버 에러지만 stale-if-error 기간 안이면 에러 대신 사본으로 응답 (에러 응답은 읽지 않고 연결을 닫음)
+  if (stale && status >= 500 && cache_within_sie(stale))
+  {
+    upstream_close(up);
+    outbuf_free(&resp);
+    return send_cache(stale, clientfd, client_keep_alive) == 0;
   }
 
-  // 헤더 끝을 알리는 빈 줄
-  sprintf(buf, "\r\n");
-  Rio_writen(serverfd, buf, strlen(buf));
-}
+  // 재검증 결과 304: 저장된 바디가 그대로 유효하므로 헤더만 갱신해 다시 저장하고 캐시에서 응답
+  if (stale && status == 304)
+  {
+    if (keep_alive)
+      upstream_put(up);
+    else
+      upstream_close(up);
+    Cache = cache_object_refresh(stale, resp.buf, resp.len, age);
+    outbuf_free(&resp);
+    if (!Cache) // 이제는 저장하면 안 되는 응답 (no-store 등): 이번만 사본으로 응답
+      return send_cache(stale, clientfd, client_keep_alive) == 0;
+
+    Cache->refcnt = 1;  // 전송하는 동안 쥐고 있을 참조 (write_cache가 캐시 몫을 더함)
+    write_cache(Cache);
+    sent = send_cache(Cache, clientfd, client_keep_alive) == 0;
+    if (stored)
+      *stored = Cache;  // 참조를 호출자에게 넘김
+    else
+      release_cache(Cache);
+    return sent;
+  }
 
+  // 저장 가능한 응답이고 기다리는 follower가 있으면 헤더를 flight에 알려 바디를 따라 받게 한다
+  // (캐시에 들어가지 않는 큰 객체도 나눠 받으므로, 인기 있는 큰 객체에 원 서버 요청이 몰리지 않음)
+  // 기다리는 follower가 없으면 바디를 flight에 쌓지 않고, 큰 응답은 아래처럼 바로 흘려보낸다
+  length_known = !has_body || (!chunked && content_length >= 0);
+  tee.flight = NULL;
+  if (flight && has_body && content_length <= FLIGHT_MAX_SHARED && cache_storable(resp.buf, resp.len) &&
+      flight_begin(flight, resp.buf, resp.len, age, length_known ? content_length : -1))
+    tee.flight = flight;
+
+  // 캐싱할 수 없는 큰 응답은 모으지 않고 바로 흘려보냄 (길이를 알고 있으므로 헤더를 먼저 보낼 수 있음)
+  // 헤더는 MSG_MORE로 보내 바로 뒤따르는 바디 앞부분과 같은 세그먼트에 실리게 한다
+  tee.max = copy_limit();
+  if (has_body && !chunked && content_length > tee.max && !tee.flight)
+  {
+    long npending = up->rio.rio_cnt < content_length ? up->rio.rio_cnt : content_length;
+    int relayed;
+
+    if (age > 0)
+      outbuf_printf(&resp, "Age: %ld\r\n", age);
+    outbuf_printf(&resp, "Connection: %s\r\n\r\n", client_keep_alive ? "keep-alive" : "close");
+    relayed = outbuf_write(&resp, clientfd, 1) == 0 &&
+              relay_body(up->fd, clientfd, up->rio.rio_bufptr, npending, content_length) == 0;
+    if (relayed && !strcasecmp(method, "GET"))
+      cache_count(0, resp.len + content_length);  // 캐시 미스 통계 (히트는 send_cache가 기록)
+    outbuf_free(&resp);
+    up->rio.rio_bufptr += npending;  // rio 버퍼에 있던 앞부분은 relay_body가 보냈음
+    up->rio.rio_cnt -= npending;
+
+    if (relayed && keep_alive)
+      upstream_put(up);
+    else
+      upstream_close(up);
+    return relayed;
+  }
 
-// 클라이언트가 보낸 요청 헤더를 읽고, 서버로 전달할 형태로 정리해서 전송
-void read_requesthdrs(rio_t *request_rio, void *request_buf, int serverfd, char *hostname, char *port)
-{
-  // 각 필수 헤더의 존재 여부를 추적할 변수들 초기화
-  int is_host_exist = 0;
-  int is_conn_exist = 0;
-  int is_proxy_conn_exist = 0;
-  int is_user_agent_exist = 0;
+  // 헤더를 먼저 보내고 바디는 도착하는 대로 흘려보낸다 (미스의 첫 바이트 지연 ≈ 원 서버의 첫 바이트 지연)
+  // 길이를 모르는 바디(chunked, 연결 종료)는 디코딩한 그대로 보내고 끝은 연결 종료로 알린다 (이 응답 후 클라이언트 연결을 닫음)
+  // GET이면 사본을 함께 모으고, 바디를 끝까지 받은 뒤에야 캐시에 넣으므로 다른 요청은 완성된 객체만 본다
+  if (!length_known)
+    client_keep_alive = 0;
+  hdrs_len = resp.len;
+  tee.clientfd = clientfd;
+  tee.sending = clientfd >= 0;
+  tee.copy = NULL;
+  tee.len = 0;
+  if (!strcasecmp(method, "GET") && content_length <= tee.max)
+  {
+    // 길이를 모르면 나중에 붙일 Content-length 줄 자리까지 비워 둠
+    tee.head = hdrs_len + (length_known ? 0 : CONTENT_LENGTH_ROOM);
+    tee.cap = length_known ? content_length : MAXBUF;
+    tee.copy = Malloc(tee.head + tee.cap + 1);
+    memcpy(tee.copy, resp.buf, hdrs_len);
+  }
 
-  // 첫 번째 줄은 doit() 함수에서 이미 읽었기 때문에 생략 가능
-  Rio_readlineb(request_rio, request_buf, MAXLINE);
+  if (age > 0)
+    outbuf_printf(&resp, "Age: %ld\r\n", age);
+  outbuf_printf(&resp, "Connection: %s\r\n\r\n", client_keep_alive ? "keep-alive" : "close");
+  if (tee.sending && outbuf_write(&resp, clientfd, content_length != 0) < 0)  // 바디가 있으면 첫 조각과 같은 세그먼트로
+    tee.sending = 0;
+  wire_len = resp.len;
+  outbuf_free(&resp);
 
-  // 빈 줄("\r\n") 전까지 반복해서 헤더 읽기
-  while (strcmp(request_buf, "\r\n")) {
+  if (has_body && stream_body(&up->rio, &tee, content_length, chunked) < 0)
+  {
+    free(tee.copy);
+    upstream_close(up);
+    return 0;
+  }
 
-    // 서버에 전송할 헤더를 저장할 버퍼
-    char write_buf[MAXLINE];
+  if (tee.flight)
+    flight_complete(tee.flight);
 
-    // 현재 헤더 라인을 처리하고, 필수 헤더 존재 여부 체크
-    handle_header_line(request_buf, write_buf,&is_host_exist, &is_conn_exist,&is_proxy_conn_exist, &is_user_agent_exist);
+  // 응답을 끝까지 읽었으니 지속 연결이면 풀에 반납
+  if (keep_alive)
+    upstream_put(up);
+  else
+    upstream_close(up);
+  sent = tee.sending;
+  if (sent && !strcasecmp(method, "GET"))
+    cache_count(0, wire_len + tee.len);
+  if (!tee.copy)
+    return sent && client_keep_alive;
+
+  // 사본의 헤더 블록은 보낸 헤더에서 Age/Connection을 뺀 것. 길이를 모르던 바디면 Content-length를 붙여 바디 바로 앞으로 맞춤
+  data = tee.copy;
+  if (!length_known)
+  {
+    char line[CONTENT_LENGTH_ROOM + 1];
+    int n = snprintf(line, sizeof(line), "Content-length: %ld\r\n", tee.len);
 
-    // 처리된 헤더를 서버로 전송
-    Rio_writen(serverfd, write_buf, strlen(write_buf));
+    data = tee.copy + tee.head - hdrs_len - n;
+    memmove(data, tee.copy, hdrs_len);
+    memcpy(data + hdrs_len, line, n);
+    hdrs_len += n;
+  }
 
-    // 다음 줄 읽기
-    Rio_readlineb(request_rio, request_buf, MAXLINE);
+  // 캐싱 가능한 경우 헤더 블록째 캐시에 저장 (저장 가능 여부와 신선 수명은 cache_object_new가 응답 헤더로 판단)
+  // 메모리 캐시에 들어가지 않는 큰 객체는 디스크 계층에만 둔다
+  if (tee.len > MAX_OBJECT_SIZE)
+  {
+    if ((Cache = cache_object_new(key, data, hdrs_len, tee.len, age)))
+    {
+      Cache->refcnt = 1;
+      disk_store(Cache);
+      release_cache(Cache);
+    }
+  }
+  else if ((Cache = cache_object_new(key, data, hdrs_len, tee.len, age)))
+  {
+    if (stored)
+    {
+      Cache->refcnt = 1;  // 호출자 몫의 참조 (write_cache가 캐시 몫을 더함)
+      *stored = Cache;
+    }
+    write_cache(Cache);  // 샤드 락은 write_cache 안에서 잡음
   }
+  free(tee.copy);  // 캐시는 슬랩에 복사본을 가짐
 
-  // 누락된 필수 헤더가 있으면 보충해서 서버로 전송
-  add_missing_headers(serverfd,is_host_exist, is_conn_exist,is_proxy_conn_exist, is_user_agent_exist,hostname, port);
+  return sent && client_keep_alive;
 }
 
-
-void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg)
+// 프록시 내부 카운터를 text/plain으로 전송, 전송에 성공하면 1
+// 바디는 outbuf에 모으므로 항목이 늘어도 길이 제한이 없고, 헤더와 함께 writev 한 번으로 보낸다
+static int send_stats(int clientfd, int keep_alive)
 {
-  char buf[MAXLINE], body[MAXBUF];
-
-  // 에러 Bdoy 생성
-  sprintf(body, "<html><title>Tiny Error</title>");
-  sprintf(body, "%s<body bgcolor="
-                "ffffff"
-                ">\r\n",
-          body);
-  sprintf(body, "%s%s: %s\r\n", body, errnum, shortmsg);
-  sprintf(body, "%s<p>%s: %s\r\n", body, longmsg, cause);
-  sprintf(body, "%s<hr><em>The Tiny Web server</em>\r\n", body);
-
-  // 에러 Header 생성 & 전송
-  sprintf(buf, "HTTP/1.0 %s %s\r\n", errnum, shortmsg);
-  Rio_writen(fd, buf, strlen(buf));
-  sprintf(buf, "Content-type: text/html\r\n");
-  Rio_writen(fd, buf, strlen(buf));
-  sprintf(buf, "Content-length: %d\r\n\r\n", (int)strlen(body));
-  Rio_writen(fd, buf, strlen(buf));
-
-  // 에러 Body 전송
-  Rio_writen(fd, body, strlen(body));
-}
+  outbuf_t body, resp;
+  resolver_stats_t rs;
+  cache_stats_t cs;
+  disk_stats_t ds;
+  snapshot_stats_t ss;
+  int ok;
+
+  outbuf_init(&body);
+  resolver_stats(&rs);
+  outbuf_printf(&body, "resolver_hits %lu\nresolver_neg_hits %lu\nresolver_misses %lu\nresolver_refreshes %lu\n",
+                rs.hits, rs.neg_hits, rs.misses, rs.refreshes);
+
+  // 캐시 정책과 객체/바이트 적중률 (정책 비교용)
+  cache_stats(&cs);
+  outbuf_printf(&body, "cache_policy %s\ncache_requests %lu\ncache_hits %lu\ncache_hit_ratio %.4f\n"
+                       "cache_bytes %lu\ncache_hit_bytes %lu\ncache_byte_hit_ratio %.4f\n",
+                cache_policy_name(), cs.requests, cs.hits, cs.requests ? (double)cs.hits / cs.requests : 0.0,
+                cs.bytes, cs.hit_bytes, cs.bytes ? (double)cs.hit_bytes / cs.bytes : 0.0);
+  outbuf_printf(&body, "cache_stored_bytes %lu\ncache_mapped_bytes %lu\n", cs.stored, cs.mapped);
+  if (disk_enabled())
+  {
+    disk_stats(&ds);
+    outbuf_printf(&body, "disk_hits %lu\ndisk_writes %lu\ndisk_write_bytes %lu\n", ds.hits, ds.writes, ds.write_bytes);
+  }
+  if (snapshot_path)
+  {
+    snapshot_stats(&ss);
+    outbuf_printf(&body, "snapshot_loaded %lu\nsnapshot_corrupt %lu\n", ss.loaded, ss.corrupt);
+  }
 
+  outbuf_init(&resp);
+  outbuf_printf(&resp, "HTTP/1.0 200 OK\r\nContent-type: text/plain\r\nContent-length: %zu\r\nConnection: %s\r\n\r\n",
+                body.len, keep_alive ? "keep-alive" : "close");
+  outbuf_append_ref(&resp, body.buf, body.len);
+  ok = outbuf_write(&resp, clientfd, 0) == 0;
+  outbuf_free(&resp);
+  outbuf_free(&body);
+  return ok;
+}
 
 // 요청 처리 함수
-void doit(int clientfd)
+// may_keep_alive가 0이면(연결당 최대 요청 수 도달) 클라이언트가 원해도 이번 응답 후 닫는다
+int doit(int clientfd, rio_t *request_rio, int may_keep_alive)
 {
-  int serverfd, content_length;
-  char request_buf[MAXLINE], response_buf[MAXLINE];
-  char method[MAXLINE], uri[MAXLINE], path[MAXLINE], hostname[MAXLINE], port[MAXLINE];
-  char *response_ptr;
-  rio_t request_rio, response_rio;
-
-  pthread_rwlock_init(&cache_lock, NULL);
-
-  // 클라이언트 요청 읽기
-  Rio_readinitb(&request_rio, clientfd);
-  Rio_readlineb(&request_rio, request_buf, MAXLINE);
+  char request_buf[MAXLINE];
+  outbuf_t req;
+  char *method, *uri, *version, path[MAXLINE], hostname[MAXLINE], port[MAXLINE];
+  int client_keep_alive, conditional, ok;
+
+  // 클라이언트 요청 읽기 (연결 종료나 유휴 타임아웃이면 0 이하)
+  if (rio_readlineb(request_rio, request_buf, MAXLINE) <= 0)
+    return 0;
   printf("Request headers:\n %s\n", request_buf);
 
-  // method, uri 추출 → uri 파싱
-  sscanf(request_buf, "%s %s", method, uri);
+  // method, uri, version 추출(request_buf 안에서 제자리 분리) → uri 파싱
+  if (http_parse_request_line(request_buf, &method, &uri, &version) < 0 || !*version)
+  {
+    clienterror(clientfd, request_buf, "400", "Bad Request", "Proxy could not parse the request");
+    return 0;
+  }
   parse_uri(uri, hostname, port, path);
+  if (strlen(hostname) > MAX_HOSTNAME || strlen(port) > MAX_PORT)
+  {
+    clienterror(clientfd, "host", "400", "Bad Request", "Host name or port too long");
+    return 0;
+  }
 
   // 지원하지 않는 method 예외 처리
   if (strcasecmp(method, "GET") && strcasecmp(method, "HEAD"))
   {
     clienterror(clientfd, method, "501", "Not implemented", "Tiny does not implement this method");
-    return;
+    return 0;
   }
 
-  // 캐시 확인 (LRU 캐시 정책 사용)
-  //LRU (Least Recently Used): 가장 오래전에 사용된 데이터를 가장 먼저 제거한다
-  CachedObject *cached_object = find_cache(path);
-  if (cached_object)
+  // 첫 줄 재구성(HTTP/1.1, 원 서버 연결 재사용) + 요청 헤더 처리
+  // 다음 요청을 읽으려면 헤더를 끝까지 소비해야 하므로 캐시 확인보다 먼저 읽는다
+  client_keep_alive = !strcasecmp(version, "HTTP/1.1"); // HTTP/1.1은 기본이 지속 연결
+  // 요청 라인과 헤더는 req 하나에 모아 두었다가 원 서버로 한 번에 보낸다
+  outbuf_init(&req);
+  outbuf_printf(&req, "%s %s HTTP/1.1\r\n", method, path);
+  if (read_requesthdrs(request_rio, &req, hostname, port, &client_keep_alive, &conditional) < 0)
   {
-    pthread_rwlock_rdlock(&cache_lock);
-    send_cache(cached_object, clientfd); // 클라이언트에게 캐시 전송
-    read_cache(cached_object);           // LRU 갱신
-    pthread_rwlock_unlock(&cache_lock);
-    return;
+    outbuf_free(&req);
+    clienterror(clientfd, uri, "400", "Bad Request", "Request headers incomplete or too large");
+    return 0;
   }
+  client_keep_alive &= may_keep_alive;
 
-  // 서버 연결
-  serverfd = Open_clientfd(hostname, port);
-  if (serverfd < 0)
-  {
-    clienterror(serverfd, method, "502", "Bad Gateway", "Failed to establish connection with the end server");
-    return;
-  }
+  ok = respond(clientfd, &req, method, hostname, port, path, client_keep_alive, conditional);
+  outbuf_free(&req);
+  return ok && client_keep_alive;
+}
 
-  // 첫 줄 재구성 후 서버로 전송
-  sprintf(request_buf, "%s %s HTTP/1.0\r\n", method, path);
-  Rio_writen(serverfd, request_buf, strlen(request_buf));
+// 캐시에 있는 만료된 사본의 검증자로 req를 조건부 요청으로 바꿈 (헤더 끝 빈 줄 앞에 끼워 넣음)
+static void add_validators(outbuf_t *req, CachedObject *stale)
+{
+  outbuf_trim(req, 2);
+  if (stale->etag.len)
+    outbuf_printf(req, "If-None-Match: %.*s\r\n", stale->etag.len, stale->etag.p);
+  if (stale->last_modified.len)
+    outbuf_printf(req, "If-Modified-Since: %.*s\r\n", stale->last_modified.len, stale->last_modified.p);
+  outbuf_append(req, "\r\n", 2);
+}
 
-  // 요청 헤더 처리
-  read_requesthdrs(&request_rio, request_buf, serverfd, hostname, port);
+// 갱신 작업 스레드에서 호출: 만료된 객체를 (검증자가 있으면 조건부로) 다시 받아 캐시를 갱신
+// 보낼 클라이언트가 없으므로 clientfd -1로 forward_request를 재사용한다
+static void refresh_entry(refresh_job_t *job)
+{
+  char key[MAXLINE];
+  http_rewrite_t rw;
+  outbuf_t req;
+  int n = strlen(job->hostname) + strlen(job->port) + strlen(user_agent_hdr) + 64;
+
+  make_cache_key(key, job->hostname, job->port, job->path);
+  outbuf_init(&req);
+  outbuf_printf(&req, "GET %s HTTP/1.1\r\n", job->path);
+  http_rewrite_init(&rw, 0);
+  outbuf_commit(&req, http_rewrite_finish(&rw, outbuf_reserve(&req, n), 1, job->hostname, job->port));
+  add_validators(&req, job->stale);
+  forward_request(-1, &req, "GET", job->hostname, job->port, key, 0, job->stale, NULL, NULL);
+  outbuf_free(&req);
+}
 
-  // 응답 헤더 수신 및 전송
-  Rio_readinitb(&response_rio, serverfd);
-  while (strcmp(response_buf, "\r\n"))
+// 헤더까지 읽은 요청에 응답 (/stats, 캐시, 원 서버 순). 응답을 온전히 보냈으면 1
+// 신선한 사본은 바로 응답하고, stale-while-revalidate 기간 안이면 만료된 사본으로 응답하며 갱신은 백그라운드에 맡긴다
+// 그 밖의 만료된 사본은 검증자(ETag/Last-Modified)가 있으면 조건부 요청으로 재검증한다
+// 클라이언트가 직접 조건부 요청을 보냈으면(conditional) 그 조건을 그대로 원 서버에 전달한다
+static int respond(int clientfd, outbuf_t *req, char *method, char *hostname, char *port, char *path, int client_keep_alive,
+                   int conditional)
+{
+  char key[MAXLINE];
+  CachedObject *stale = NULL;
+
+  // 프록시 자신에게 온 요청 (GET /stats): 내부 카운터 출력
+  if (!hostname[0] && !strcmp(path, "/stats"))
+    return send_stats(clientfd, client_keep_alive);
+
+  // 캐시 확인 (교체 정책은 --cache-policy로 선택, 기본 LRU)
+  //LRU (Least Recently Used): 가장 오래전에 사용된 데이터를 가장 먼저 제거한다 (policy.c에 다른 정책들)
+  // 샤드 락은 조회 동안만 잡고, 전송은 참조만 들고 락 없이 진행한다
+  // 캐시는 바디를 함께 보내므로 GET만 캐시에서 응답
+  make_cache_key(key, hostname, port, path);
+  CachedObject *cached_object = strcasecmp(method, "GET") ? NULL : find_cache(key); // 히트면 정책 갱신 + 참조 획득
+  if (cached_object && !cache_is_fresh(cached_object) &&
+      !(cache_within_swr(cached_object) && refresh_submit(cached_object, hostname, port, path) == 0))
   {
-    Rio_readlineb(&response_rio, response_buf, MAXLINE);
-    if (strstr(response_buf, "Content-length"))
-      content_length = atoi(strchr(response_buf, ':') + 1);
-    Rio_writen(clientfd, response_buf, strlen(response_buf));
+    // 만료: 재검증하거나 에러 시 대신 쓸 수 있으면 참조를 들고 원 서버로, 아니면 미스처럼 새로 받아 교체
+    if (!conditional &&
+        (cached_object->etag.len || cached_object->last_modified.len || cache_within_sie(cached_object)))
+      stale = cached_object;
+    else
+      release_cache(cached_object);
+    cached_object = NULL;
   }
-
-  // 응답 본문 수신 및 전송
-  response_ptr = malloc(content_length);
-  Rio_readnb(&response_rio, response_ptr, content_length);
-  Rio_writen(clientfd, response_ptr, content_length);
-
-  // 캐싱 가능한 경우 캐시에 저장
-  if (content_length <= MAX_OBJECT_SIZE)
+  if (cached_object)
   {
-    pthread_rwlock_wrlock(&cache_lock);
-    CachedObject *Cache = (CachedObject *)calloc(1, sizeof(CachedObject));
-    Cache->response_ptr = response_ptr;
-    Cache->content_length = content_length;
-    strcpy(Cache->path, path);
-    write_cache(Cache);
-    pthread_rwlock_unlock(&cache_lock);
+    int sent = send_cache(cached_object, clientfd, client_keep_alive) == 0; // 클라이언트에게 캐시 전송 (락 없음)
+    release_cache(cached_object);        // 참조 반납
+    return sent;
   }
-  else
-    free(response_ptr);  // 캐싱 안 하는 경우 메모리 해제
 
-  Close(serverfd);
+  // 메모리에 들어가지 않는 큰 객체는 디스크 계층에서 바로 응답 (작은 객체는 find_cache가 메모리로 올림)
+  int rc;
+  if (!stale && !strcasecmp(method, "GET") && (rc = disk_send(key, clientfd, client_keep_alive)) >= 0)
+    return rc;
+
+  // 캐시 미스: 같은 객체를 받아오는 중인 스레드가 있으면 합류 (single-flight)
+  // leader가 헤더를 받았으면 지금까지 받은 바이트부터 따라 받고, 끝난 뒤라면 그 결과를 받는다
+  // HEAD는 캐시를 쓰지 않으므로 합류하지 않는다
+  int leader = 0;
+  flight_t *flight = strcasecmp(method, "GET") ? NULL : flight_join(key, &leader);
+  if (flight && !leader)
+  {
+    if (flight_wait(flight, &cached_object))
+    {
+      if (stale)
+        release_cache(stale);
+      return flight_stream(flight, clientfd, client_keep_alive);
+    }
+    if (cached_object)
+    {
+      if (stale)
+        release_cache(stale);
+      int sent = send_cache(cached_object, clientfd, client_keep_alive) == 0;
+      release_cache(cached_object);
+      return sent;
+    }
+    flight = NULL;  // leader가 캐싱하지 못한 응답이면 직접 요청
+  }
+  else if (flight && (cached_object = find_cache(key)) && cache_is_fresh(cached_object))
+  {
+    // 미스 직후 다른 leader가 막 저장을 끝낸 경우: 원 서버에 가지 않고 그 결과를 나눠 줌
+    if (stale)
+      release_cache(stale);
+    flight_finish(flight, cached_object);
+    int sent = send_cache(cached_object, clientfd, client_keep_alive) == 0;
+    release_cache(cached_object);
+    return sent;
+  }
+  else if (cached_object)
+    release_cache(cached_object);  // 재확인했지만 여전히 만료된 사본
+
+  // 원 서버로 전달 (연결 풀 사용). 만료된 사본이 있으면 조건부 요청으로 보내 304면 그 사본을 갱신해 응답
+  if (stale)
+    add_validators(req, stale);
+  CachedObject *stored = NULL;
+  int ok = forward_request(clientfd, req, method, hostname, port, key, client_keep_alive, stale, flight,
+                           flight ? &stored : NULL);
+  if (stale)
+    release_cache(stale);
+  if (flight)
+  {
+    flight_finish(flight, stored);  // 기다리던 follower들에게 결과 전달
+    if (stored)
+      release_cache(stored);
+  }
+  return ok;
 }
 
 
@@ -303,17 +922,28 @@ void doit(int clientfd)
 void parse_uri(char *uri, char *hostname, char *port, char *path)
 {
   char *hostname_ptr = strstr(uri, "//") ? strstr(uri, "//") + 2 : uri;
-  char *port_ptr = strchr(hostname_ptr, ':');  // : 뒤는 포트
   char *path_ptr = strchr(hostname_ptr, '/');  // /부터는 경로
-  strcpy(path, path_ptr);  // path 복사
+  char *port_ptr = strchr(hostname_ptr, ':');  // : 뒤는 포트
+
+  // 경로가 없는 경우(http://host:port) 문자열 끝을 경로 시작으로 보고 "/" 사용
+  if (!path_ptr)
+    path_ptr = hostname_ptr + strlen(hostname_ptr);
+  strcpy(path, *path_ptr ? path_ptr : "/");  // path 복사
+
+  // 경로 안의 ':'는 포트 구분자가 아님
+  if (port_ptr && port_ptr > path_ptr)
+    port_ptr = NULL;
 
   if (port_ptr) {
     // 포트가 명시된 경우: hostname:port/path
     strncpy(port, port_ptr + 1, path_ptr - port_ptr - 1);
+    port[path_ptr - port_ptr - 1] = '\0';
     strncpy(hostname, hostname_ptr, port_ptr - hostname_ptr);
+    hostname[port_ptr - hostname_ptr] = '\0';
   } else {
     // 포트가 없는 경우: 기본 포트 할당
     strcpy(port, is_local_test ? "80" : "8000");
     strncpy(hostname, hostname_ptr, path_ptr - hostname_ptr);
+    hostname[path_ptr - hostname_ptr] = '\0';
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,18 @@
+//webproxy-lab/sweeetpotatooo/proxy.h
+#ifndef __PROXY_H__
+#define __PROXY_H__
+
+#include "csapp.h"
+
+#define MAX_HOSTNAME 255  // 요청 URI의 호스트 이름 최대 길이 (DNS 이름 한도, 넘으면 400)
+#define MAX_PORT 5        // 포트 번호 최대 자릿수
+#define CLIENTERROR_BUFSIZE (MAXLINE + MAXBUF) // format_clienterror가 쓰는 에러 응답 최대 크기
+#define CLIENTERROR_CAUSE_MAX 256              // 에러 바디에 보여 줄 원인(cause) 최대 길이
+
+// proxy.c의 요청 파싱/헤더 재작성 함수들 (스레드 엔진과 epoll 엔진이 공유)
+void parse_uri(char *uri, char *hostname, char *port, char *path);
+int format_clienterror(char *buf, char *cause, char *errnum, char *shortmsg, char *longmsg);
+
+extern const char *user_agent_hdr;  // 프록시가 사용하는 고정 User-Agent
+
+#endif /* __PROXY_H__ */
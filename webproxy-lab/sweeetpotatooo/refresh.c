@@ -0,0 +1,78 @@
+#include "csapp.h"
+#include "refresh.h"
+
+// 갱신 작업 대기열 (sbuf와 같은 세마포어 구조, 다만 넣을 때 막히지 않음)
+// 요청 스레드가 대기열 때문에 멈추면 stale-while-revalidate의 의미가 없으므로,
+// 빈 슬롯이 없으면 sem_trywait이 실패하고 호출자는 직접 재검증한다.
+static struct
+{
+  refresh_job_t *buf;
+  int n, front, rear;
+  sem_t mutex, slots, items;
+  refresh_fn fn;
+} queue;
+
+static void *refresh_worker(void *vargp)
+{
+  refresh_job_t job;
+
+  Pthread_detach(pthread_self());
+  while (1)
+  {
+    P(&queue.items);
+    P(&queue.mutex);
+    job = queue.buf[(++queue.front) % queue.n];
+    V(&queue.mutex);
+    V(&queue.slots);
+
+    queue.fn(&job);
+    cache_end_refresh(job.stale); // 성공했으면 이미 새 객체로 교체됨, 실패했으면 다음 요청이 다시 시도
+    release_cache(job.stale);
+    free(job.hostname);
+    free(job.port);
+    free(job.path);
+  }
+  return NULL;
+}
+
+// 작업 스레드 nthreads개와 queue_size칸 대기열 생성 (서버 시작 시 한 번)
+void refresh_init(int nthreads, int queue_size, refresh_fn fn)
+{
+  pthread_t tid;
+
+  queue.buf = Calloc(queue_size, sizeof(refresh_job_t));
+  queue.n = queue_size;
+  queue.front = queue.rear = 0;
+  queue.fn = fn;
+  Sem_init(&queue.mutex, 0, 1);
+  Sem_init(&queue.slots, 0, queue_size);
+  Sem_init(&queue.items, 0, 0);
+  for (int i = 0; i < nthreads; i++)
+    Pthread_create(&tid, NULL, refresh_worker, NULL);
+}
+
+// 만료된 객체의 갱신을 맡김. 갱신이 진행 중이면(이번에 맡겼거나 이미 누가 하는 중) 0, 맡기지 못했으면 -1
+// 0이면 호출자는 stale 사본으로 바로 응답해도 된다. 작업은 stale의 참조를 하나 따로 잡는다.
+int refresh_submit(CachedObject *stale, char *hostname, char *port, char *path)
+{
+  if (!queue.n)
+    return -1;
+  if (!cache_begin_refresh(stale))
+    return 0;
+  if (sem_trywait(&queue.slots) < 0)
+  {
+    cache_end_refresh(stale);
+    return -1;
+  }
+
+  hold_cache(stale);
+  P(&queue.mutex);
+  refresh_job_t *job = &queue.buf[(++queue.rear) % queue.n];
+  job->stale = stale;
+  job->hostname = strdup(hostname);
+  job->port = strdup(port);
+  job->path = strdup(path);
+  V(&queue.mutex);
+  V(&queue.items);
+  return 0;
+}
@@ -0,0 +1,24 @@
+//webproxy-lab/sweeetpotatooo/refresh.h
+#ifndef __REFRESH_H__
+#define __REFRESH_H__
+
+#include "csapp.h"
+#include "cache.h"
+
+// 백그라운드 갱신 작업 하나: 만료된 캐시 객체(참조 보유)와 원 서버 요청에 필요한 정보
+typedef struct
+{
+  CachedObject *stale;
+  char *hostname, *port, *path;
+} refresh_job_t;
+
+// 작업 스레드가 작업마다 호출하는 함수 (원 서버에서 받아 캐시를 갱신)
+typedef void (*refresh_fn)(refresh_job_t *job);
+
+// stale-while-revalidate용 갱신 작업 풀
+// 요청 스레드는 만료된 사본으로 바로 응답하고 refresh_submit()으로 갱신만 맡긴다.
+// 객체마다 갱신은 하나만 진행되고(CachedObject.refreshing), 대기열이 가득 차면 맡기지 않는다.
+void refresh_init(int nthreads, int queue_size, refresh_fn fn);
+int refresh_submit(CachedObject *stale, char *hostname, char *port, char *path);
+
+#endif /* __REFRESH_H__ */
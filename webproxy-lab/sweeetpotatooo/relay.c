@@ -0,0 +1,102 @@
+// splice()는 _GNU_SOURCE가 있어야 선언되는데, csapp.h와 함께 쓰면 선언이 충돌하므로 이 파일은 csapp.h 없이 빌드한다.
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "relay.h"
+
+// 캐싱하지 않는 큰 응답 바디를 원 서버 소켓에서 클라이언트 소켓으로 그대로 옮긴다.
+// splice(): 소켓 → 파이프 → 소켓으로 커널 안에서만 이동 (사용자 공간 복사 없음)
+// splice를 쓸 수 없으면 RELAY_BUFSIZE 크기의 고정 버퍼로 read/write 반복
+// 파이프는 스레드마다 하나씩 만들어 재사용하고, 중간에 실패해 데이터가 남으면 버린다.
+
+static __thread int pipefd[2] = {-1, -1};
+
+// n바이트를 모두 쓸 때까지 반복, 실패하면 -1
+static int write_all(int fd, char *buf, long n)
+{
+  ssize_t w;
+
+  while (n > 0)
+  {
+    if ((w = write(fd, buf, n)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    buf += w;
+    n -= w;
+  }
+  return 0;
+}
+
+static void drop_pipe(void)
+{
+  close(pipefd[0]);
+  close(pipefd[1]);
+  pipefd[0] = pipefd[1] = -1;
+}
+
+// splice로 len바이트 이동. 성공 0, 실패 -1, splice를 지원하지 않는 fd면 1 (아무것도 옮기지 않은 상태)
+static int splice_body(int srcfd, int dstfd, long len)
+{
+  ssize_t in, out;
+
+  if (pipefd[0] < 0 && pipe(pipefd) < 0)
+    return 1;
+
+  while (len > 0)
+  {
+    in = splice(srcfd, NULL, pipefd[1], NULL, len, SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (in < 0 && errno == EINTR)
+      continue;
+    if (in < 0 && (errno == EINVAL || errno == ENOSYS))
+      return 1;
+    if (in <= 0) // 원 서버가 일찍 끊음
+      return -1;
+    len -= in;
+
+    // 파이프에 들어온 만큼 클라이언트로
+    while (in > 0)
+    {
+      out = splice(pipefd[0], NULL, dstfd, NULL, in, SPLICE_F_MOVE | (len ? SPLICE_F_MORE : 0));
+      if (out < 0 && errno == EINTR)
+        continue;
+      if (out <= 0)
+      {
+        drop_pipe(); // 남은 데이터가 다음 응답에 섞이지 않도록
+        return -1;
+      }
+      in -= out;
+    }
+  }
+  return 0;
+}
+
+// srcfd에서 dstfd로 바디 len바이트 전달. pending은 이미 rio 버퍼에 읽혀 있던 앞부분 (npending바이트)
+// 전부 전달했으면 0, 어느 쪽이든 실패하면 -1
+int relay_body(int srcfd, int dstfd, char *pending, long npending, long len)
+{
+  char buf[RELAY_BUFSIZE];
+  ssize_t n;
+  int rc;
+
+  if (write_all(dstfd, pending, npending) < 0)
+    return -1;
+  len -= npending;
+
+  if ((rc = splice_body(srcfd, dstfd, len)) <= 0)
+    return rc;
+
+  // splice 불가: 고정 크기 버퍼로 복사
+  while (len > 0)
+  {
+    if ((n = read(srcfd, buf, len < RELAY_BUFSIZE ? len : RELAY_BUFSIZE)) < 0 && errno == EINTR)
+      continue;
+    if (n <= 0 || write_all(dstfd, buf, n) < 0)
+      return -1;
+    len -= n;
+  }
+  return 0;
+}
@@ -0,0 +1,9 @@
+//webproxy-lab/sweeetpotatooo/relay.h
+#ifndef __RELAY_H__
+#define __RELAY_H__
+
+#define RELAY_BUFSIZE 65536 // splice를 못 쓸 때 사용하는 복사 창 크기
+
+int relay_body(int srcfd, int dstfd, char *pending, long npending, long len);
+
+#endif /* __RELAY_H__ */
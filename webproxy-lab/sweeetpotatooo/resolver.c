@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include "csapp.h"
+#include "resolver.h"
+
+// 조회 흐름
+// resolver_lookup(): "host:port"를 슬롯에서 찾아 유효하면 복사해서 반환 (성공/실패 모두 캐싱)
+//                   없거나 만료됐으면 락 밖에서 getaddrinfo 후 슬롯에 저장
+//                   만료가 가까운 항목은 그대로 반환하고 갱신 스레드를 하나 띄움
+// resolver_connect(): 조회한 주소들로 차례로 연결 시도 (open_clientfd 대체)
+
+typedef struct
+{
+  pthread_mutex_t lock;
+  char key[RESOLVER_KEYLEN]; // "" 이면 빈 슬롯
+  time_t expires;
+  int refreshing;            // 갱신 스레드가 이미 돌고 있으면 1
+  int naddrs;                // 0이면 실패 결과(negative entry)
+  resolved_addr_t addrs[RESOLVER_MAX_ADDRS];
+} resolver_slot;
+
+// 갱신 스레드에 넘기는 인자
+typedef struct
+{
+  char hostname[RESOLVER_KEYLEN];
+  char port[RESOLVER_KEYLEN];
+} refresh_arg;
+
+static resolver_slot slots[RESOLVER_SLOTS];
+static pthread_once_t slots_once = PTHREAD_ONCE_INIT;
+static resolver_stats_t stats;
+
+static void init_slots(void)
+{
+  for (int i = 0; i < RESOLVER_SLOTS; i++)
+    pthread_mutex_init(&slots[i].lock, NULL);
+}
+
+// FNV-1a
+static unsigned hash_key(const char *s)
+{
+  unsigned h = 2166136261u;
+
+  while (*s)
+  {
+    h ^= (unsigned char)*s++;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// getaddrinfo 결과를 최대 max개 복사, 실패하면 0
+static int resolve(char *hostname, char *port, resolved_addr_t *addrs, int max)
+{
+  struct addrinfo hints, *listp, *p;
+  int n = 0;
+
+  memset(&hints, 0, sizeof(struct addrinfo));
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_NUMERICSERV | AI_ADDRCONFIG;
+  if (getaddrinfo(hostname, port, &hints, &listp) != 0)
+    return 0;
+
+  for (p = listp; p && n < max; p = p->ai_next)
+  {
+    if (p->ai_addrlen > sizeof(struct sockaddr_storage))
+      continue;
+    addrs[n].family = p->ai_family;
+    addrs[n].socktype = p->ai_socktype;
+    addrs[n].protocol = p->ai_protocol;
+    addrs[n].addrlen = p->ai_addrlen;
+    memcpy(&addrs[n].addr, p->ai_addr, p->ai_addrlen);
+    n++;
+  }
+  freeaddrinfo(listp);
+  return n;
+}
+
+// 조회 결과를 슬롯에 저장 (다른 이름이 차지하고 있었다면 덮어씀)
+static void store(resolver_slot *s, char *key, resolved_addr_t *addrs, int n)
+{
+  pthread_mutex_lock(&s->lock);
+  strcpy(s->key, key);
+  s->expires = time(NULL) + (n ? RESOLVER_TTL : RESOLVER_NEG_TTL);
+  s->naddrs = n;
+  memcpy(s->addrs, addrs, n * sizeof(resolved_addr_t));
+  s->refreshing = 0;
+  pthread_mutex_unlock(&s->lock);
+}
+
+// 만료 전 갱신 스레드: 조회 후 저장만 하고 종료
+static void *refresh_thread(void *vargp)
+{
+  refresh_arg *arg = vargp;
+  resolved_addr_t addrs[RESOLVER_MAX_ADDRS];
+  char key[RESOLVER_KEYLEN];
+  int n;
+
+  Pthread_detach(pthread_self());
+  // 잘린 키는 다른 이름의 슬롯과 겹칠 수 있으므로 저장하지 않음 (resolver_lookup도 캐시를 거치지 않음)
+  if (snprintf(key, sizeof(key), "%s:%s", arg->hostname, arg->port) >= (int)sizeof(key))
+  {
+    free(arg);
+    return NULL;
+  }
+  n = resolve(arg->hostname, arg->port, addrs, RESOLVER_MAX_ADDRS);
+  if (n) // 갱신 실패면 기존 주소를 만료까지 그대로 사용
+    store(&slots[hash_key(key) % RESOLVER_SLOTS], key, addrs, n);
+  else
+  {
+    resolver_slot *s = &slots[hash_key(key) % RESOLVER_SLOTS];
+    pthread_mutex_lock(&s->lock);
+    if (!strcmp(s->key, key))
+      s->refreshing = 0;
+    pthread_mutex_unlock(&s->lock);
+  }
+  free(arg);
+  return NULL;
+}
+
+// hostname:port의 주소를 최대 max개 addrs에 채우고 개수 반환, 이름을 찾을 수 없으면 -1
+int resolver_lookup(char *hostname, char *port, resolved_addr_t *addrs, int max)
+{
+  char key[RESOLVER_KEYLEN];
+  resolved_addr_t found[RESOLVER_MAX_ADDRS];
+  resolver_slot *s;
+  time_t now = time(NULL);
+  int n, refresh = 0;
+
+  if (max > RESOLVER_MAX_ADDRS)
+    max = RESOLVER_MAX_ADDRS;
+
+  // 너무 긴 이름은 캐시를 거치지 않음
+  if (snprintf(key, sizeof(key), "%s:%s", hostname, port) >= (int)sizeof(key))
+  {
+    __atomic_fetch_add(&stats.misses, 1, __ATOMIC_RELAXED);
+    return (n = resolve(hostname, port, addrs, max)) ? n : -1;
+  }
+
+  pthread_once(&slots_once, init_slots);
+  s = &slots[hash_key(key) % RESOLVER_SLOTS];
+
+  pthread_mutex_lock(&s->lock);
+  if (!strcmp(s->key, key) && s->expires > now)
+  {
+    n = s->naddrs < max ? s->naddrs : max;
+    memcpy(addrs, s->addrs, n * sizeof(resolved_addr_t));
+    if (n && !s->refreshing && s->expires - now <= RESOLVER_REFRESH_AHEAD)
+      s->refreshing = refresh = 1;
+    pthread_mutex_unlock(&s->lock);
+
+    __atomic_fetch_add(n ? &stats.hits : &stats.neg_hits, 1, __ATOMIC_RELAXED);
+    if (refresh)
+    {
+      pthread_t tid;
+      refresh_arg *arg = Malloc(sizeof(refresh_arg));
+      strcpy(arg->hostname, hostname); // key에 들어갔으니 길이는 안전
+      strcpy(arg->port, port);
+      __atomic_fetch_add(&stats.refreshes, 1, __ATOMIC_RELAXED);
+      if (pthread_create(&tid, NULL, refresh_thread, arg) != 0)
+      {
+        free(arg);
+        pthread_mutex_lock(&s->lock);
+        s->refreshing = 0;
+        pthread_mutex_unlock(&s->lock);
+      }
+    }
+    return n ? n : -1;
+  }
+  pthread_mutex_unlock(&s->lock);
+
+  // 미스: 느린 getaddrinfo는 락 밖에서
+  __atomic_fetch_add(&stats.misses, 1, __ATOMIC_RELAXED);
+  n = resolve(hostname, port, found, RESOLVER_MAX_ADDRS);
+  store(s, key, found, n);
+  if (n > max)
+    n = max;
+  memcpy(addrs, found, n * sizeof(resolved_addr_t));
+  return n ? n : -1;
+}
+
+// open_clientfd와 같은 동작을 캐시된 주소로 수행, 실패 시 -1
+int resolver_connect(char *hostname, char *port)
+{
+  resolved_addr_t addrs[RESOLVER_MAX_ADDRS];
+  int n, fd;
+
+  if ((n = resolver_lookup(hostname, port, addrs, RESOLVER_MAX_ADDRS)) < 0)
+    return -1;
+
+  for (int i = 0; i < n; i++)
+  {
+    if ((fd = socket(addrs[i].family, addrs[i].socktype, addrs[i].protocol)) < 0)
+      continue;
+    if (connect(fd, (struct sockaddr *)&addrs[i].addr, addrs[i].addrlen) == 0)
+      return fd;
+    close(fd);
+  }
+  return -1;
+}
+
+void resolver_stats(resolver_stats_t *st)
+{
+  st->hits = __atomic_load_n(&stats.hits, __ATOMIC_RELAXED);
+  st->neg_hits = __atomic_load_n(&stats.neg_hits, __ATOMIC_RELAXED);
+  st->misses = __atomic_load_n(&stats.misses, __ATOMIC_RELAXED);
+  st->refreshes = __atomic_load_n(&stats.refreshes, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,34 @@
+//webproxy-lab/sweeetpotatooo/resolver.h
+#ifndef __RESOLVER_H__
+#define __RESOLVER_H__
+
+#include "csapp.h"
+
+#define RESOLVER_SLOTS 256        // 캐시 항목 수 (direct-mapped, 충돌 시 덮어씀)
+#define RESOLVER_MAX_ADDRS 4      // 이름 하나당 보관하는 주소 수
+#define RESOLVER_KEYLEN 256       // "host:port" 최대 길이 (넘으면 캐시 없이 바로 조회)
+#define RESOLVER_TTL 60           // 조회 성공 결과 보관 시간 (초)
+#define RESOLVER_NEG_TTL 5        // 조회 실패 결과 보관 시간 (초)
+#define RESOLVER_REFRESH_AHEAD 10 // 만료까지 이 시간 이하로 남은 항목이 조회되면 백그라운드로 갱신
+
+// getaddrinfo 결과 하나를 복사해 둔 것
+typedef struct
+{
+  int family, socktype, protocol;
+  socklen_t addrlen;
+  struct sockaddr_storage addr;
+} resolved_addr_t;
+
+typedef struct
+{
+  unsigned long hits;      // 캐시된 주소로 응답
+  unsigned long neg_hits;  // 캐시된 실패로 응답
+  unsigned long misses;    // getaddrinfo 호출
+  unsigned long refreshes; // 만료 전 백그라운드 갱신
+} resolver_stats_t;
+
+int resolver_lookup(char *hostname, char *port, resolved_addr_t *addrs, int max);
+int resolver_connect(char *hostname, char *port);
+void resolver_stats(resolver_stats_t *st);
+
+#endif /* __RESOLVER_H__ */
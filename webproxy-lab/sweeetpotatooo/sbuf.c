@@ -0,0 +1,42 @@
+#include "csapp.h"
+#include "sbuf.h"
+
+// n개의 슬롯을 가진 빈 버퍼 생성
+void sbuf_init(sbuf_t *sp, int n)
+{
+  sp->buf = Calloc(n, sizeof(int));
+  sp->n = n;                  // 최대 n개 항목
+  sp->front = sp->rear = 0;   // front == rear 이면 빈 버퍼
+  Sem_init(&sp->mutex, 0, 1); // 상호 배제용 이진 세마포어
+  Sem_init(&sp->slots, 0, n); // 처음에는 n개 슬롯이 모두 비어 있음
+  Sem_init(&sp->items, 0, 0); // 처음에는 항목이 없음
+}
+
+// 버퍼 메모리 해제
+void sbuf_deinit(sbuf_t *sp)
+{
+  Free(sp->buf);
+}
+
+// 버퍼 뒤에 항목 추가 (가득 차 있으면 빈 슬롯이 생길 때까지 대기)
+void sbuf_insert(sbuf_t *sp, int item)
+{
+  P(&sp->slots);                          // 빈 슬롯 대기
+  P(&sp->mutex);                          // 버퍼 잠금
+  sp->buf[(++sp->rear) % (sp->n)] = item; // 항목 삽입
+  V(&sp->mutex);                          // 버퍼 해제
+  V(&sp->items);                          // 항목 생김을 알림
+}
+
+// 버퍼 앞의 항목을 꺼내 반환 (비어 있으면 항목이 생길 때까지 대기)
+int sbuf_remove(sbuf_t *sp)
+{
+  int item;
+
+  P(&sp->items);                           // 항목 대기
+  P(&sp->mutex);                           // 버퍼 잠금
+  item = sp->buf[(++sp->front) % (sp->n)]; // 항목 꺼내기
+  V(&sp->mutex);                           // 버퍼 해제
+  V(&sp->slots);                           // 빈 슬롯 생김을 알림
+  return item;
+}
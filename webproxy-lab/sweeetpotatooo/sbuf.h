@@ -0,0 +1,26 @@
+//webproxy-lab/sweeetpotatooo/sbuf.h
+#ifndef __SBUF_H__
+#define __SBUF_H__
+
+#include "csapp.h"
+
+// 유한 크기 생산자-소비자 버퍼 (CS:APP sbuf 패키지)
+// 메인 스레드가 accept한 연결 fd를 넣고(sbuf_insert), 작업 스레드가 꺼낸다(sbuf_remove).
+// 버퍼가 가득 차면 sbuf_insert가 막히므로 accept가 멈추고 대기 연결은 커널 backlog에 쌓인다.
+typedef struct
+{
+  int *buf;    // 연결 fd 배열
+  int n;       // 최대 슬롯 수
+  int front;   // buf[(front+1)%n]이 첫 항목
+  int rear;    // buf[rear%n]이 마지막 항목
+  sem_t mutex; // buf 접근 보호
+  sem_t slots; // 빈 슬롯 수
+  sem_t items; // 사용 가능한 항목 수
+} sbuf_t;
+
+void sbuf_init(sbuf_t *sp, int n);
+void sbuf_deinit(sbuf_t *sp);
+void sbuf_insert(sbuf_t *sp, int item);
+int sbuf_remove(sbuf_t *sp);
+
+#endif /* __SBUF_H__ */
@@ -0,0 +1,220 @@
+#include <sys/mman.h>
+#include "csapp.h"
+#include "slab.h"
+
+// 크기 등급: 64바이트부터 약 1.25배씩, SLAB_LARGE까지 (모두 16의 배수라 청크가 16바이트 정렬됨)
+// 등급마다 락과 빈 청크가 남은 페이지 목록을 따로 가진다.
+// 페이지는 필요할 때 mmap하고, 청크는 앞에서부터 잘라 쓰다가(bump) 반납된 청크는 free 목록으로 재사용한다.
+// 페이지의 청크가 모두 반납되면 등급마다 한 장만 남겨 두고 munmap한다.
+
+#define SLAB_CLASSES 32
+#define SLAB_MIN 64
+
+typedef struct slab_class slab_class_t;
+
+// 페이지 맨 앞의 관리 정보 (청크는 그 뒤부터)
+typedef struct slab_page
+{
+  slab_class_t *cls;
+  int used;                      // 사용 중인 청크 수
+  char *free;                    // 반납된 청크 목록 (청크 첫 8바이트에 다음 청크 주소)
+  char *bump, *end;              // 아직 한 번도 쓰지 않은 영역
+  struct slab_page *prev, *next; // 빈 청크가 있는 페이지 목록
+} slab_page_t;
+
+// 모든 청크 앞의 16바이트: 속한 페이지 (전용 매핑이면 NULL과 매핑 크기)
+typedef struct
+{
+  slab_page_t *page;
+  size_t size;
+} chunk_hdr_t;
+
+struct slab_class
+{
+  pthread_mutex_t lock;
+  size_t size;          // 청크 크기 (헤더 포함)
+  slab_page_t *partial; // 빈 청크가 남은 페이지들
+  slab_page_t *spare;   // 완전히 빈 페이지 한 장 (바로 다시 쓰일 때 mmap을 아낌)
+};
+
+static slab_class_t classes[SLAB_CLASSES];
+static int nclasses;
+static pthread_once_t slab_once = PTHREAD_ONCE_INIT;
+static size_t mapped; // OS에서 받은 바이트 (원자적으로 갱신)
+
+static void slab_init(void)
+{
+  size_t size = SLAB_MIN;
+
+  while (nclasses < SLAB_CLASSES && size < SLAB_LARGE)
+  {
+    pthread_mutex_init(&classes[nclasses].lock, NULL);
+    classes[nclasses++].size = size;
+    size = (size + size / 4 + 15) & ~(size_t)15;
+  }
+  pthread_mutex_init(&classes[nclasses].lock, NULL);
+  classes[nclasses++].size = SLAB_LARGE; // 마지막 등급은 정확히 SLAB_LARGE
+}
+
+static void *map(size_t n)
+{
+  void *p = mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (p == MAP_FAILED)
+    unix_error("slab: mmap error");
+  __atomic_add_fetch(&mapped, n, __ATOMIC_RELAXED);
+  return p;
+}
+
+static void unmap(void *p, size_t n)
+{
+  munmap(p, n);
+  __atomic_sub_fetch(&mapped, n, __ATOMIC_RELAXED);
+}
+
+static void page_link(slab_class_t *c, slab_page_t *pg)
+{
+  pg->prev = NULL;
+  pg->next = c->partial;
+  if (c->partial)
+    c->partial->prev = pg;
+  c->partial = pg;
+}
+
+static void page_unlink(slab_class_t *c, slab_page_t *pg)
+{
+  if (pg->prev)
+    pg->prev->next = pg->next;
+  else
+    c->partial = pg->next;
+  if (pg->next)
+    pg->next->prev = pg->prev;
+}
+
+// 등급 c의 청크 하나 (락을 잡은 상태)
+static chunk_hdr_t *class_alloc(slab_class_t *c)
+{
+  slab_page_t *pg = c->partial;
+  char *chunk;
+
+  if (!pg)
+  {
+    if ((pg = c->spare))
+      c->spare = NULL;
+    else
+    {
+      pg = map(SLAB_PAGE);
+      pg->cls = c;
+      pg->used = 0;
+      pg->free = NULL;
+      pg->bump = (char *)pg + ((sizeof(slab_page_t) + 15) & ~(size_t)15);
+      pg->end = (char *)pg + SLAB_PAGE;
+    }
+    page_link(c, pg);
+  }
+
+  if (pg->free)
+  {
+    chunk = pg->free;
+    pg->free = *(char **)chunk;
+  }
+  else
+  {
+    chunk = pg->bump;
+    pg->bump += c->size;
+  }
+  pg->used++;
+  if (!pg->free && pg->bump + c->size > pg->end) // 가득 참
+    page_unlink(c, pg);
+  ((chunk_hdr_t *)chunk)->page = pg;
+  return (chunk_hdr_t *)chunk;
+}
+
+// n바이트 요청을 담을 등급 번호 (전용 매핑이면 -1)
+static int class_of(size_t n)
+{
+  size_t need = n + sizeof(chunk_hdr_t);
+  int i;
+
+  pthread_once(&slab_once, slab_init);
+  if (need > SLAB_LARGE)
+    return -1;
+  for (i = 0; classes[i].size < need; i++)
+    ;
+  return i;
+}
+
+// n바이트를 할당하면 실제로 잡힐 바이트 (할당하지 않고 크기만 필요한 시뮬레이터용)
+size_t slab_size(size_t n)
+{
+  int i = class_of(n);
+
+  return i < 0 ? SLAB_LARGE_RESERVE(n) : classes[i].size;
+}
+
+void *slab_alloc(size_t n, size_t *reserved)
+{
+  int i = class_of(n);
+  size_t need;
+  chunk_hdr_t *h;
+
+  if (i < 0)
+  {
+    need = SLAB_LARGE_RESERVE(n);
+    h = map(need);
+    h->page = NULL;
+    h->size = need;
+  }
+  else
+  {
+    pthread_mutex_lock(&classes[i].lock);
+    h = class_alloc(&classes[i]);
+    pthread_mutex_unlock(&classes[i].lock);
+    h->size = need = classes[i].size;
+  }
+  if (reserved)
+    *reserved = need;
+  return h + 1;
+}
+
+void slab_free(void *p)
+{
+  chunk_hdr_t *h = (chunk_hdr_t *)p - 1;
+  slab_page_t *pg = h->page;
+  slab_class_t *c;
+  int was_full;
+
+  if (!pg)
+  {
+    unmap(h, h->size);
+    return;
+  }
+
+  c = pg->cls;
+  pthread_mutex_lock(&c->lock);
+  was_full = !pg->free && pg->bump + c->size > pg->end;
+  *(char **)h = pg->free;
+  pg->free = (char *)h;
+  if (was_full)
+    page_link(c, pg);
+  if (--pg->used == 0)
+  {
+    // 빈 페이지: 한 장은 남겨 두고 나머지는 OS에 반환
+    page_unlink(c, pg);
+    if (c->spare)
+      unmap(pg, SLAB_PAGE);
+    else
+    {
+      pg->free = NULL;
+      pg->bump = (char *)pg + ((sizeof(slab_page_t) + 15) & ~(size_t)15);
+      c->spare = pg;
+    }
+  }
+  pthread_mutex_unlock(&c->lock);
+}
+
+// 슬랩이 OS에서 받아 쥐고 있는 전체 바이트
+size_t slab_mapped(void)
+{
+  return __atomic_load_n(&mapped, __ATOMIC_RELAXED);
+}
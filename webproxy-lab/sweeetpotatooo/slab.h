@@ -0,0 +1,23 @@
+//webproxy-lab/sweeetpotatooo/slab.h
+#ifndef __SLAB_H__
+#define __SLAB_H__
+
+#include "csapp.h"
+
+#define SLAB_PAGE (16 * 1024)       // 작은 청크들을 잘라 쓰는 페이지 크기 (mmap 단위, 캐시가 작아 등급마다 빈 공간이 적게)
+#define SLAB_LARGE (SLAB_PAGE / 4)  // 헤더 포함 이보다 큰 요청은 객체마다 전용 매핑
+#define SLAB_OS_PAGE 4096           // 전용 매핑의 반올림 단위
+
+// 전용 매핑으로 n바이트를 요청했을 때 실제로 잡히는 바이트 (청크 헤더 포함, 정적 검사용)
+#define SLAB_LARGE_RESERVE(n) ((((n) + 16) + SLAB_OS_PAGE - 1) / SLAB_OS_PAGE * SLAB_OS_PAGE)
+
+// 캐시 객체 전용 메모리 관리자 (크기 등급별 슬랩)
+// n바이트 요청은 n 이상인 가장 작은 등급의 청크 하나로, SLAB_LARGE보다 크면 전용 mmap으로 처리한다.
+// 비게 된 페이지와 전용 매핑은 바로 OS에 돌려주므로 교체가 잦아도 RSS가 저장된 양을 따라 줄어든다.
+// *reserved에는 실제로 잡힌 바이트(등급 크기 또는 매핑 크기)를 돌려준다. 캐시 용량은 이 값으로 센다.
+void *slab_alloc(size_t n, size_t *reserved);
+size_t slab_size(size_t n);
+void slab_free(void *p);
+size_t slab_mapped(void);
+
+#endif /* __SLAB_H__ */
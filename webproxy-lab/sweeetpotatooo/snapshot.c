@@ -0,0 +1,272 @@
+#include <stddef.h>
+#include <sys/mman.h>
+#include "csapp.h"
+#include "snapshot.h"
+
+#define SNAP_MAGIC 0x50414e53u   // "SNAP"
+#define SNAP_VERSION 1
+#define RECORD_MAGIC 0x21434552u // "REC!"
+#define SUM_SEED 14695981039346656037ULL
+
+// 파일 맨 앞
+typedef struct
+{
+  uint32_t magic, version;
+  uint64_t count;      // 기록 수
+  uint64_t table_size; // 테이블 슬롯 수 (2의 거듭제곱, count의 2배 이상)
+  uint64_t file_size;  // 잘린 파일을 거르기 위한 전체 크기
+  uint64_t sum;        // 헤더(sum 앞까지) + 테이블 체크섬
+} snap_header_t;
+
+// 테이블 슬롯 (hash 0은 빈 칸, linear probing)
+typedef struct
+{
+  uint64_t hash; // 키 해시 | 1
+  uint64_t off;  // 기록 위치 (파일 처음부터)
+} snap_slot_t;
+
+// 기록 헤더 (뒤에 키(NUL 포함), 헤더 블록, 바디, 8바이트 정렬 패딩)
+typedef struct
+{
+  uint32_t magic, key_len, header_length, content_length;
+  int64_t stored_at, initial_age, expires;
+  uint64_t slot; // 이 기록을 가리키는 테이블 슬롯 (한 번만 올리도록 taken을 표시)
+  uint64_t sum;  // 키 + 헤더 블록 + 바디 체크섬
+} snap_record_t;
+
+#define RECORD_LEN(key_len, hl, cl) ((sizeof(snap_record_t) + (uint64_t)(key_len) + (hl) + (cl) + 7) & ~(uint64_t)7)
+
+static char *base;              // mmap한 스냅샷 (한 번 열면 끝까지 유지, 읽는 중인 스레드가 있을 수 있음)
+static size_t map_len;
+static snap_header_t *hdr;
+static snap_slot_t *table;
+static unsigned char *taken;    // 슬롯마다 이미 메모리로 올렸는지 (원자적으로 교환)
+static int active;              // 아직 올릴 기록이 남았으면 1 (find_cache가 미스마다 조회)
+static snapshot_stats_t stats;  // 원자적으로만 갱신
+
+// 64비트 단위 FNV 변형 체크섬 (바이트 단위보다 8배 적게 곱하고, 상위 비트를 하위로 섞음)
+static uint64_t checksum(uint64_t h, const void *p, size_t n)
+{
+  const unsigned char *c = p;
+  uint64_t w;
+
+  for (; n >= 8; n -= 8, c += 8)
+  {
+    memcpy(&w, c, 8);
+    h = (h ^ w) * 1099511628211ULL;
+    h ^= h >> 32;
+  }
+  while (n--)
+    h = (h ^ *c++) * 1099511628211ULL;
+  return h;
+}
+
+static uint64_t header_sum(snap_header_t *h, snap_slot_t *t)
+{
+  return checksum(checksum(SUM_SEED, h, offsetof(snap_header_t, sum)), t, h->table_size * sizeof(snap_slot_t));
+}
+
+// off의 기록 헤더가 파일 안에 온전히 있으면 반환 (바디 체크섬은 올릴 때 확인), 아니면 NULL
+static snap_record_t *record_at(uint64_t off)
+{
+  snap_record_t *r;
+
+  if (off % 8 || off + sizeof(*r) > map_len)
+    return NULL;
+  r = (snap_record_t *)(base + off);
+  if (r->magic != RECORD_MAGIC || !r->key_len || r->key_len > MAXLINE || r->slot >= hdr->table_size ||
+      off + RECORD_LEN(r->key_len, r->header_length, r->content_length) > map_len ||
+      ((char *)(r + 1))[r->key_len - 1])
+    return NULL;
+  return r;
+}
+
+// 기록 r을 캐시 객체로 만듦 (refcnt 0). 이미 누가 올렸거나 체크섬이 맞지 않으면 NULL
+// 나이 기준(stored_at, initial_age, expires)은 덤프할 때 값 그대로 되살린다
+static CachedObject *materialize(snap_record_t *r)
+{
+  char *key = (char *)(r + 1);
+  CachedObject *Cache;
+
+  if (__atomic_exchange_n(&taken[r->slot], 1, __ATOMIC_ACQ_REL))
+    return NULL;
+  if (checksum(SUM_SEED, key, (size_t)r->key_len + r->header_length + r->content_length) != r->sum)
+  {
+    __atomic_fetch_add(&stats.corrupt, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  if (!(Cache = cache_object_new(key, key + r->key_len, r->header_length, r->content_length, 0)))
+    return NULL;
+  Cache->stored_at = r->stored_at;
+  Cache->initial_age = r->initial_age;
+  Cache->expires = r->expires;
+  __atomic_fetch_add(&stats.loaded, 1, __ATOMIC_RELAXED);
+  return Cache;
+}
+
+// 백그라운드로 기록을 파일 순서(샤드별로 먼저 제거될 것부터)대로 모두 올림
+// 이 순서로 insert하므로 덤프할 때의 정책 순서가 재현된다 (요청이 먼저 올린 기록과 이미 더 새로운 객체가 있는 키는 건너뜀)
+static void *loader(void *vargp)
+{
+  uint64_t off = sizeof(snap_header_t) + hdr->table_size * sizeof(snap_slot_t);
+  snap_record_t *r;
+  CachedObject *Cache;
+
+  Pthread_detach(pthread_self());
+  for (uint64_t i = 0; i < hdr->count && (r = record_at(off)); i++)
+  {
+    if ((Cache = materialize(r)))
+    {
+      Cache->refcnt = 1;
+      write_cache_absent(Cache);
+      release_cache(Cache);
+    }
+    off += RECORD_LEN(r->key_len, r->header_length, r->content_length);
+  }
+
+  // 남은 기록이 없으니 미스마다 조회하지 않고, 읽은 페이지도 돌려줌 (매핑은 조회 중인 스레드를 위해 유지)
+  __atomic_store_n(&active, 0, __ATOMIC_RELEASE);
+  madvise(base, map_len, MADV_DONTNEED);
+  return NULL;
+}
+
+// path의 스냅샷을 mmap하고 헤더와 테이블을 확인한 뒤 백그라운드로 올리기 시작. 없거나 깨졌으면 -1
+// 기록 내용은 여기서 읽지 않으므로 시작 시간은 테이블 크기(객체 수)에만 비례한다
+int snapshot_open(const char *path)
+{
+  struct stat st;
+  snap_header_t *h;
+  pthread_t tid;
+  void *p;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) < 0)
+    return -1;
+  if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(snap_header_t) ||
+      (p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+  {
+    close(fd);
+    return -1;
+  }
+  close(fd);
+
+  h = p;
+  if (h->magic != SNAP_MAGIC || h->version != SNAP_VERSION || h->file_size != (uint64_t)st.st_size ||
+      !h->table_size || (h->table_size & (h->table_size - 1)) || h->count > h->table_size ||
+      h->table_size > (st.st_size - sizeof(*h)) / sizeof(snap_slot_t) || header_sum(h, (snap_slot_t *)(h + 1)) != h->sum)
+  {
+    munmap(p, st.st_size);
+    return -1;
+  }
+
+  base = p;
+  map_len = st.st_size;
+  hdr = h;
+  table = (snap_slot_t *)(h + 1);
+  taken = Calloc(h->table_size, 1);
+  madvise(base, map_len, MADV_SEQUENTIAL);  // 백그라운드 적재는 앞에서부터 순서대로 읽음
+  __atomic_store_n(&active, 1, __ATOMIC_RELEASE);
+  Pthread_create(&tid, NULL, loader, NULL);
+  return 0;
+}
+
+// 메모리 캐시 미스 때 스냅샷에 아직 올리지 않은 key의 기록이 있으면 캐시 객체로 만들어 반환 (refcnt 0, 없으면 NULL)
+CachedObject *snapshot_load(char *key)
+{
+  uint64_t hash, mask, i;
+  snap_record_t *r;
+
+  if (!__atomic_load_n(&active, __ATOMIC_ACQUIRE))
+    return NULL;
+  hash = cache_key_hash(key) | 1;
+  mask = hdr->table_size - 1;
+  for (i = hash & mask; table[i].hash; i = (i + 1) & mask)
+    if (table[i].hash == hash && (r = record_at(table[i].off)) && r->slot == i && !strcmp((char *)(r + 1), key))
+      return materialize(r);
+  return NULL;
+}
+
+// 지금 캐시에 있는 객체를 path에 덤프 (path.tmp에 쓰고 fsync 후 rename하므로 도중에 죽어도 이전 스냅샷은 남음)
+// 객체는 참조만 잡고 락 없이 쓴다. 실패하면 -1
+int snapshot_save(const char *path)
+{
+  CachedObject **objs;
+  snap_header_t h;
+  snap_slot_t *t;
+  snap_record_t r;
+  uint64_t *slot_of, off, mask, j;
+  char tmp[MAXLINE], pad[8] = {0};
+  FILE *fp;
+  int n, rc = -1;
+
+  n = cache_objects(&objs);
+  memset(&h, 0, sizeof(h));
+  h.magic = SNAP_MAGIC;
+  h.version = SNAP_VERSION;
+  h.count = n;
+  for (h.table_size = 16; h.table_size < (uint64_t)n * 2; h.table_size *= 2)
+    ;
+  t = Calloc(h.table_size, sizeof(snap_slot_t));
+  slot_of = Malloc((n + 1) * sizeof(uint64_t));
+
+  // 기록 위치를 먼저 정해 테이블을 채움 (캐시 키는 샤드를 통틀어 유일)
+  mask = h.table_size - 1;
+  off = sizeof(h) + h.table_size * sizeof(snap_slot_t);
+  for (int i = 0; i < n; i++)
+  {
+    uint64_t hash = cache_key_hash(objs[i]->path) | 1;
+
+    for (j = hash & mask; t[j].hash; j = (j + 1) & mask)
+      ;
+    t[j] = (snap_slot_t){hash, off};
+    slot_of[i] = j;
+    off += RECORD_LEN(strlen(objs[i]->path) + 1, objs[i]->header_length, objs[i]->content_length);
+  }
+  h.file_size = off;
+  h.sum = header_sum(&h, t);
+
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  if ((fp = fopen(tmp, "w")))
+  {
+    int ok = fwrite(&h, sizeof(h), 1, fp) == 1 && fwrite(t, sizeof(snap_slot_t), h.table_size, fp) == h.table_size;
+
+    for (int i = 0; ok && i < n; i++)
+    {
+      CachedObject *Cache = objs[i];
+      size_t data_len = (size_t)Cache->header_length + Cache->content_length;
+
+      memset(&r, 0, sizeof(r));
+      r.magic = RECORD_MAGIC;
+      r.key_len = strlen(Cache->path) + 1;
+      r.header_length = Cache->header_length;
+      r.content_length = Cache->content_length;
+      r.stored_at = Cache->stored_at;
+      r.initial_age = Cache->initial_age;
+      r.expires = Cache->expires;
+      r.slot = slot_of[i];
+      // 키와 헤더 블록 + 바디는 서로 붙어 있음 (cache_object_alloc)
+      r.sum = checksum(SUM_SEED, Cache->path, r.key_len + data_len);
+      ok = fwrite(&r, sizeof(r), 1, fp) == 1 && fwrite(Cache->path, 1, r.key_len + data_len, fp) == r.key_len + data_len &&
+           fwrite(pad, 1, RECORD_LEN(r.key_len, 0, data_len) - sizeof(r) - r.key_len - data_len, fp) ==
+               RECORD_LEN(r.key_len, 0, data_len) - sizeof(r) - r.key_len - data_len;
+    }
+    ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0 && ok;
+    if (fclose(fp) == 0 && ok && rename(tmp, path) == 0)
+      rc = 0;
+    else
+      unlink(tmp);
+  }
+
+  for (int i = 0; i < n; i++)
+    release_cache(objs[i]);
+  free(objs);
+  free(slot_of);
+  free(t);
+  return rc;
+}
+
+void snapshot_stats(snapshot_stats_t *st)
+{
+  st->loaded = __atomic_load_n(&stats.loaded, __ATOMIC_RELAXED);
+  st->corrupt = __atomic_load_n(&stats.corrupt, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,26 @@
+//webproxy-lab/sweeetpotatooo/snapshot.h
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <stdint.h>
+
+#include "csapp.h"
+#include "cache.h"
+
+// 재시작용 메모리 캐시 스냅샷 (--snapshot=FILE로 켬)
+// SIGUSR1이나 SIGTERM을 받으면 캐시에 있는 객체(키, 메타데이터, 헤더 블록, 바디)를
+// 샤드별 정책 순서(먼저 제거될 것부터)로 FILE에 덤프하고, 다음 실행은 시작할 때 FILE을 mmap해 다시 쓴다.
+// 파일: [헤더][키 해시 → 기록 위치 테이블][기록...]. 헤더와 테이블은 열 때, 기록은 읽을 때마다 체크섬으로 확인한다.
+// 열 때는 테이블만 확인하므로 시작 시간은 스냅샷 크기와 거의 무관하고, 바디는 필요할 때 페이지 단위로 읽힌다:
+// 요청이 미스하면 그 키의 기록을 바로 올리고(snapshot_load), 백그라운드 스레드가 나머지를 기록 순서대로 올린다.
+typedef struct
+{
+  unsigned long loaded, corrupt;  // 메모리로 올린 기록, 체크섬이 맞지 않아 버린 기록
+} snapshot_stats_t;
+
+int snapshot_open(const char *path);
+CachedObject *snapshot_load(char *key);
+int snapshot_save(const char *path);
+void snapshot_stats(snapshot_stats_t *st);
+
+#endif /* __SNAPSHOT_H__ */
@@ -0,0 +1,11 @@
+// accept4()는 _GNU_SOURCE가 있어야 선언되는데, csapp.h와 함께 쓰면 선언이 충돌하므로 이 파일은 csapp.h 없이 빌드한다.
+#define _GNU_SOURCE
+#include <sys/socket.h>
+#include "cloexec.h"
+
+// accept와 같지만 연결 fd를 close-on-exec로 받음 (fork와 사이에 틈이 없도록 한 번에)
+// 동시 모드에서 다른 스레드가 띄운 CGI 자식이 이 연결을 물려받으면, 그 자식이 끝날 때까지 연결이 닫히지 않는다
+int accept_cloexec(int listenfd, struct sockaddr *addr, socklen_t *addrlen)
+{
+  return accept4(listenfd, addr, addrlen, SOCK_CLOEXEC);
+}
@@ -0,0 +1,9 @@
+//webproxy-lab/sweeetpotatooo/tiny/cloexec.h
+#ifndef __CLOEXEC_H__
+#define __CLOEXEC_H__
+
+#include <sys/socket.h>
+
+int accept_cloexec(int listenfd, struct sockaddr *addr, socklen_t *addrlen);
+
+#endif /* __CLOEXEC_H__ */
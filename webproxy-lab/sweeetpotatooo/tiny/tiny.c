@@ -7,11 +7,36 @@
  *   - Fixed sprintf() aliasing issue in serve_static(), and clienterror().
  */
 #include "csapp.h"
+#include "cloexec.h"
+#include <sys/sendfile.h>
 
+#define FDCACHE_SLOTS 64     // 열린 파일 캐시 항목 수 (direct-mapped, 충돌 시 기존 파일을 닫고 교체)
+#define FDCACHE_REVALIDATE 1 // 캐시된 stat 결과를 다시 확인하지 않고 믿는 시간 (초)
+#define MAX_WORKERS 256      // 동시 모드의 최대 작업 스레드 수
+#define VALIDATOR_LEN 64     // ETag, Last-Modified 값 버퍼 크기
+
+// 열어 둔 정적 파일 하나: 매 요청마다 open/stat/mmap/munmap 하지 않고 fd와 stat 결과를 재사용
+typedef struct {
+  char filename[MAXLINE]; // "" 이면 빈 슬롯
+  int fd;
+  struct stat st;
+  time_t checked;         // 마지막으로 stat으로 확인한 시각
+} fdcache_entry;
+
+// 작업 스레드마다 따로 가지므로 락도, 다른 스레드가 쓰는 fd를 닫을 걱정도 없다
+static __thread fdcache_entry fdcache[FDCACHE_SLOTS];
+
+void serve_forever(int listenfd); // 연결 수락 → 처리 반복
+void *worker(void *vargp); // 동시 모드 작업 스레드
+int open_reuseport_listenfd(char *port); // 스레드별 리스닝 소켓 (SO_REUSEPORT)
 void doit(int fd); // 
-void read_requesthdrs(rio_t *rp); // 요청 헤더 읽기
+int fdcache_open(char *filename, struct stat *st); // 정적 파일 fd 얻기 (캐시)
+void read_requesthdrs(rio_t *rp, char *if_none_match, char *if_modified_since); // 요청 헤더 읽기 (조건부 요청 헤더 값 보관)
 int parse_uri(char *uri, char *filename, char *cgiargs); // URI 분석
-void serve_static(int fd, char *filename, int filesize); // 정적 콘텐츠 제공
+void make_validators(struct stat *st, char *etag, char *last_modified); // 파일의 ETag, Last-Modified 값
+int not_modified(struct stat *st, char *if_none_match, char *if_modified_since); // 조건부 요청이 304로 끝나는지
+void serve_not_modified(int fd, struct stat *st); // 304 응답
+void serve_static(int fd, char *filename, int srcfd, struct stat *st); // 정적 콘텐츠 제공
 void serve_dynamic(int fd, char *filename, char *cgiargs); // 동적 콘텐츠 제공
 void get_filetype(char *filename, char *filetype); // 파일 타입 결정
 void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg); // 클라이언트 오류 처리
@@ -21,24 +46,64 @@ FILE *log_file;
 int main(int argc, char **argv)
 {
   // log_file = fopen("tiny.log", 'a');
-  int listenfd, connfd; // 서버 소켓fd와 클라이언트 소켓fd
-  char hostname[MAXLINE], port[MAXLINE]; // 클라이언트 호스트명과 포트
-  socklen_t clientlen; // 클라이언트 주소 길이
-  struct sockaddr_storage clientaddr; // 클라이언트 주소 구조체
+  int nworkers = 0; // 0이면 기존처럼 한 번에 한 연결씩 처리 (iterative)
+  pthread_t tid;
 
   /* Check command line args */
-  if (argc != 2)
+  if (argc != 2 && argc != 3)
   {
-    fprintf(stderr, "usage: %s <port>\n", argv[0]);
+    fprintf(stderr, "usage: %s <port> [nworkers]\n", argv[0]);
     exit(1);
   }
+  if (argc == 3 && ((nworkers = atoi(argv[2])) < 1 || nworkers > MAX_WORKERS))
+  {
+    fprintf(stderr, "nworkers must be between 1 and %d\n", MAX_WORKERS);
+    exit(1);
+  }
+
+  if (!nworkers)
+  {
+    int listenfd = Open_listenfd(argv[1]); // 리스닝 소켓 생성
+    fcntl(listenfd, F_SETFD, FD_CLOEXEC);  // CGI 자식이 포트를 물려받지 않게
+    serve_forever(listenfd);
+  }
+
+  // 동시 모드: 작업 스레드마다 같은 포트에 SO_REUSEPORT 리스닝 소켓을 따로 열어,
+  // 커널이 새 연결을 스레드들에 나눠 준다 (느린 클라이언트는 자기 스레드만 붙잡음)
+  Signal(SIGPIPE, SIG_IGN); // 클라이언트가 먼저 끊어도 서버 전체가 죽지 않게
+  for (int i = 0; i < nworkers; i++)
+  {
+    int listenfd = open_reuseport_listenfd(argv[1]);
+    if (listenfd < 0)
+      unix_error("open_reuseport_listenfd error");
+    Pthread_create(&tid, NULL, worker, (void *)(long)listenfd);
+  }
+  Pthread_exit(NULL); // 메인 스레드만 끝내고 작업 스레드는 계속
+}
+
+void serve_forever(int listenfd)
+{
+  int connfd; // 클라이언트 소켓fd
+  char hostname[MAXLINE], port[MAXLINE]; // 클라이언트 호스트명과 포트
+  socklen_t clientlen; // 클라이언트 주소 길이
+  struct sockaddr_storage clientaddr; // 클라이언트 주소 구조체
 
-  listenfd = Open_listenfd(argv[1]); // 리스닝 소켓 생성
   while (1)
   {
     clientlen = sizeof(clientaddr);
-    connfd = Accept(listenfd, (SA *)&clientaddr, &clientlen); // 클라이언트의 연결 요청 수락
-    Getnameinfo((SA *)&clientaddr, clientlen, hostname, MAXLINE, port, MAXLINE, 0); // 클라이언트 주소 정보 가져오기
+    // 클라이언트의 연결 요청 수락. 실패해도(먼저 끊은 연결, fd 부족 등) 서버를 끝내지 않고 다시 기다림
+    // close-on-exec로 받아, 다른 스레드가 띄운 CGI 자식이 이 연결을 물려받아 닫힘(응답 끝)을 늦추지 않게 한다
+    if ((connfd = accept_cloexec(listenfd, (SA *)&clientaddr, &clientlen)) < 0)
+    {
+      if (errno != EINTR && errno != ECONNABORTED)
+        fprintf(stderr, "accept error: %s\n", strerror(errno));
+      if (errno == EMFILE || errno == ENFILE)
+        usleep(10000); // fd가 반납될 때까지 잠깐 쉼 (바로 다시 시도하면 계속 실패하며 CPU만 씀)
+      continue;
+    }
+    // 클라이언트 주소 정보 가져오기 (실패해도 요청은 처리)
+    if (getnameinfo((SA *)&clientaddr, clientlen, hostname, MAXLINE, port, MAXLINE, 0) != 0)
+      strcpy(hostname, "?"), strcpy(port, "?");
     printf("Accepted connection from (%s, %s)\n", hostname, port); // 클라이언트의 연결 정보 출력
     // fprintf(log_file, "Accepted connection from (%s, %s)\n", hostname, port); 
     doit(connfd);  // 클라이언트 요청 처리
@@ -47,17 +112,53 @@ int main(int argc, char **argv)
   }
 }
 
+void *worker(void *vargp)
+{
+  Pthread_detach(pthread_self());
+  serve_forever((int)(long)vargp);
+  return NULL;
+}
+
+// open_listenfd와 같지만 SO_REUSEPORT를 켜서 같은 포트에 여러 소켓을 bind할 수 있게 함
+int open_reuseport_listenfd(char *port)
+{
+  struct addrinfo hints, *listp, *p;
+  int listenfd = -1, optval = 1;
+
+  memset(&hints, 0, sizeof(struct addrinfo));
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE | AI_ADDRCONFIG | AI_NUMERICSERV;
+  if (getaddrinfo(NULL, port, &hints, &listp) != 0)
+    return -1;
+
+  for (p = listp; p; p = p->ai_next) {
+    if ((listenfd = socket(p->ai_family, p->ai_socktype | SOCK_CLOEXEC, p->ai_protocol)) < 0)
+      continue;
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, (const void *)&optval, sizeof(int));
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, (const void *)&optval, sizeof(int));
+    if (bind(listenfd, p->ai_addr, p->ai_addrlen) == 0 && listen(listenfd, LISTENQ) == 0)
+      break;
+    close(listenfd);
+    listenfd = -1;
+  }
+  freeaddrinfo(listp);
+  return listenfd;
+}
+
 void doit(int fd)
 {
   int is_static;
   struct stat sbuf;
   char buf[MAXLINE], method[MAXLINE], uri[MAXLINE], version[MAXLINE];
   char filename[MAXLINE], cgiargs[MAXLINE];
+  char if_none_match[MAXLINE], if_modified_since[MAXLINE];
   rio_t rio;
 
   // 요청 읽기
+  // 동시 모드에서 한 클라이언트의 에러가 서버 전체를 종료시키지 않도록, 연결 입출력은 소문자 rio 함수 사용
   Rio_readinitb(&rio, fd);
-  Rio_readlineb(&rio, buf, MAXLINE);
+  if (rio_readlineb(&rio, buf, MAXLINE) <= 0) // 요청 없이 끊긴 연결
+    return;
   printf("Request headers: \n");
   printf("%s", buf);
   sscanf(buf, "%s %s %s", method, uri, version);
@@ -65,30 +166,40 @@ void doit(int fd)
     clienterror(fd, method, "501", "Not implemented", "Tiny does not implement this method");
     return;
   }
-  read_requesthdrs(&rio); // 요청 헤더 읽기
+  read_requesthdrs(&rio, if_none_match, if_modified_since); // 요청 헤더 읽기
 
   // GET 요청에서 받은 URI 분석 
   is_static = parse_uri(uri, filename, cgiargs);
-  if (stat(filename, &sbuf) < 0) {
-    clienterror(fd, filename, "404", "Not found", "Tiny couldn't find this file");
-    return;
-  }
 
   if (is_static) {
-    if (!(S_ISREG(sbuf.st_mode)) || !(S_IRUSR & sbuf.st_mode)) { // 파일이 정적이고 읽기 권한이 없으면
+    int srcfd = fdcache_open(filename, &sbuf); // 캐시된 fd + stat (없으면 열어서 캐시)
+    if (srcfd < 0 && errno != EACCES) {
+      clienterror(fd, filename, "404", "Not found", "Tiny couldn't find this file");
+      return;
+    }
+    if (srcfd < 0 || !(S_ISREG(sbuf.st_mode)) || !(S_IRUSR & sbuf.st_mode)) { // 파일이 정적이고 읽기 권한이 없으면
       clienterror(fd, filename, "403", "Forbidden", "Tiny couldn't read the file");
       return;
     }
-    serve_static(fd, filename, sbuf.st_size);
-  }
-
-  else {
-    if (!(S_ISREG(sbuf.st_mode)) || !(S_IXUSR & sbuf.st_mode)) { // 파일이 동적이고 실행 권한이 없으면
-      clienterror(fd, filename, "403", "Forbidden", "Tiny couldn't run the CGI program");
+    // 조건부 요청: 클라이언트(프록시 캐시)가 가진 사본이 그대로면 바디 없이 304
+    if (not_modified(&sbuf, if_none_match, if_modified_since)) {
+      serve_not_modified(fd, &sbuf);
       return;
     }
-    serve_dynamic(fd, filename, cgiargs);
+    serve_static(fd, filename, srcfd, &sbuf);
+    return;
+  }
+
+  if (stat(filename, &sbuf) < 0) {
+    clienterror(fd, filename, "404", "Not found", "Tiny couldn't find this file");
+    return;
+  }
+
+  if (!(S_ISREG(sbuf.st_mode)) || !(S_IXUSR & sbuf.st_mode)) { // 파일이 동적이고 실행 권한이 없으면
+    clienterror(fd, filename, "403", "Forbidden", "Tiny couldn't run the CGI program");
+    return;
   }
+  serve_dynamic(fd, filename, cgiargs);
 }
 
 void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longmsg) 
@@ -104,21 +215,29 @@ void clienterror(int fd, char *cause, char *errnum, char *shortmsg, char *longms
 
   // HTTP 응답 출력
   sprintf(buf, "HTTP/1.0 %s %s\r\n", errnum, shortmsg);
-  Rio_writen(fd, buf, strlen(buf));
+  rio_writen(fd, buf, strlen(buf));
   sprintf(buf, "Content-type: text/html\r\n");
-  Rio_writen(fd, buf, strlen(buf));
+  rio_writen(fd, buf, strlen(buf));
   sprintf(buf, "Content-length: %d\r\n\r\n", (int)strlen(body));
-  Rio_writen(fd, buf, strlen(buf));
-  Rio_writen(fd, body, strlen(body));
+  rio_writen(fd, buf, strlen(buf));
+  rio_writen(fd, body, strlen(body));
 }
 
-void read_requesthdrs(rio_t *rp)
+void read_requesthdrs(rio_t *rp, char *if_none_match, char *if_modified_since)
 {
   char buf[MAXLINE];
 
-  Rio_readlineb(rp, buf, MAXLINE);
+  if_none_match[0] = if_modified_since[0] = '\0';
+  if (rio_readlineb(rp, buf, MAXLINE) <= 0)
+    return;
   while(strcmp(buf, "\r\n")) {
-    Rio_readlineb(rp, buf, MAXLINE);
+    // 조건부 요청 헤더는 값만 보관 (줄 끝 CRLF 제외)
+    if (!strncasecmp(buf, "If-None-Match:", 14))
+      sscanf(buf + 14, " %[^\r\n]", if_none_match);
+    else if (!strncasecmp(buf, "If-Modified-Since:", 18))
+      sscanf(buf + 18, " %[^\r\n]", if_modified_since);
+    if (rio_readlineb(rp, buf, MAXLINE) <= 0) // 헤더 도중 끊김
+      return;
     printf("%s", buf);
   }
   return;
@@ -153,28 +272,131 @@ int parse_uri(char *uri, char *filename, char *cgiargs)
   }
 }
 
-void serve_static(int fd, char *filename, int filesize) 
+// 파일명으로 fdcache 슬롯 선택
+static fdcache_entry *fdcache_slot(char *filename)
+{
+  unsigned h = 5381;
+
+  for (char *p = filename; *p; p++)
+    h = h * 33 + (unsigned char)*p;
+  return &fdcache[h % FDCACHE_SLOTS];
+}
+
+// 정적 파일의 열린 fd와 stat 결과 반환, 실패 시 -1 (errno 유지)
+// 캐시된 stat은 FDCACHE_REVALIDATE초 동안 그대로 믿고, 그 뒤에는 stat으로 파일이 바뀌었는지
+// (inode, 크기, 수정 시각) 확인해서 바뀌었으면 닫고 다시 연다. 반환된 fd는 캐시 소유라 닫으면 안 된다.
+int fdcache_open(char *filename, struct stat *st)
 {
+  fdcache_entry *e = fdcache_slot(filename);
+  time_t now = time(NULL);
+  struct stat cur;
   int srcfd;
-  char *srcp, filetype[MAXLINE], buf[MAXBUF];
 
-  // 클라이언트에게 응답 헤더 전송
+  if (e->filename[0] && !strcmp(e->filename, filename)) {
+    if (now - e->checked < FDCACHE_REVALIDATE) {
+      *st = e->st;
+      return e->fd;
+    }
+    if (stat(filename, &cur) == 0 && cur.st_ino == e->st.st_ino && cur.st_size == e->st.st_size &&
+        cur.st_mtime == e->st.st_mtime) {
+      e->checked = now;
+      *st = e->st;
+      return e->fd;
+    }
+  }
+
+  // 없거나 바뀐 파일: 슬롯 비우고 새로 열기
+  if (e->filename[0]) {
+    Close(e->fd);
+    e->filename[0] = '\0';
+  }
+  if ((srcfd = open(filename, O_RDONLY | O_CLOEXEC, 0)) < 0) // CGI 자식에게 물려주지 않음
+    return -1;
+  if (fstat(srcfd, st) < 0 || !S_ISREG(st->st_mode)) { // 디렉터리 등은 캐시하지 않음
+    Close(srcfd);
+    errno = EACCES;
+    return -1;
+  }
+  strcpy(e->filename, filename);
+  e->fd = srcfd;
+  e->st = *st;
+  e->checked = now;
+  return srcfd;
+}
+
+// ETag는 (inode, 크기, 수정 시각)으로 만들어 파일이 바뀌면 값도 바뀐다. Last-Modified는 HTTP 날짜 형식
+void make_validators(struct stat *st, char *etag, char *last_modified)
+{
+  struct tm tm;
+
+  sprintf(etag, "\"%lx-%lx-%lx\"", (unsigned long)st->st_ino, (unsigned long)st->st_size, (unsigned long)st->st_mtime);
+  gmtime_r(&st->st_mtime, &tm);
+  strftime(last_modified, VALIDATOR_LEN, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+// If-None-Match가 있으면 그것만 보고(ETag 목록 중 하나가 같거나 "*"), 없으면 If-Modified-Since 이후 수정됐는지 확인
+int not_modified(struct stat *st, char *if_none_match, char *if_modified_since)
+{
+  static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  char etag[VALIDATOR_LEN], last_modified[VALIDATOR_LEN], mon[4];
+  struct tm tm = {0};
+  const char *m;
+
+  make_validators(st, etag, last_modified);
+  if (if_none_match[0])
+    return strstr(if_none_match, etag) || !strcmp(if_none_match, "*");
+  if (!if_modified_since[0])
+    return 0;
+
+  // IMF-fixdate: "Sun, 06 Nov 1994 08:49:37 GMT"
+  if (sscanf(if_modified_since, "%*3s, %2d %3s %4d %2d:%2d:%2d GMT", &tm.tm_mday, mon, &tm.tm_year, &tm.tm_hour,
+             &tm.tm_min, &tm.tm_sec) != 6 || !(m = strstr(months, mon)) || (m - months) % 3)
+    return 0;
+  tm.tm_mon = (m - months) / 3;
+  tm.tm_year -= 1900;
+  return st->st_mtime <= timegm(&tm);
+}
+
+void serve_not_modified(int fd, struct stat *st)
+{
+  char etag[VALIDATOR_LEN], last_modified[VALIDATOR_LEN], buf[MAXBUF];
+  int len;
+
+  make_validators(st, etag, last_modified);
+  len = sprintf(buf, "HTTP/1.0 304 Not Modified\r\nServer: Tiny Web Server\r\nConnection: close\r\n"
+                     "ETag: %s\r\nLast-Modified: %s\r\n\r\n", etag, last_modified);
+  rio_writen(fd, buf, len);
+  printf("Response headers: \n");
+  printf("%s", buf);
+}
+
+void serve_static(int fd, char *filename, int srcfd, struct stat *st) 
+{
+  char filetype[MAXLINE], buf[MAXBUF], etag[VALIDATOR_LEN], last_modified[VALIDATOR_LEN];
+  off_t offset = 0, filesize = st->st_size;
+  ssize_t n;
+  int len;
+
+  // 클라이언트에게 응답 헤더 전송 (MSG_MORE: 바디 첫 부분과 같은 세그먼트로 나가도록 커널에 붙잡아 둠)
+  // ETag/Last-Modified가 있어야 프록시 캐시가 만료 후 조건부 요청으로 재검증할 수 있다
   get_filetype(filename, filetype);
-  sprintf(buf, "HTTP/1.0 200 OK\r\n");
-  sprintf(buf, "%sServer: Tiny Web Server\r\n", buf);
-  sprintf(buf, "%sConnection: close\r\n", buf);
-  sprintf(buf, "%sContent-length: %d\r\n", buf, filesize);
-  sprintf(buf, "%sContent-type: %s\r\n\r\n", buf, filetype);
-  Rio_writen(fd, buf, strlen(buf));
+  make_validators(st, etag, last_modified);
+  len = snprintf(buf, sizeof(buf), "HTTP/1.0 200 OK\r\nServer: Tiny Web Server\r\nConnection: close\r\n"
+                 "Content-length: %ld\r\nContent-type: %s\r\nETag: %s\r\nLast-Modified: %s\r\n\r\n",
+                 (long)filesize, filetype, etag, last_modified);
+  if (send(fd, buf, len, filesize ? MSG_MORE : 0) < 0)
+    return;
   printf("Response headers: \n");
   printf("%s", buf);
 
-  // 클라이언트에게 응답 바디 전송
-  srcfd = Open(filename, O_RDONLY, 0);
-  srcp = Mmap(0, filesize, PROT_READ, MAP_PRIVATE, srcfd, 0);
-  Close(srcfd);
-  Rio_writen(fd, srcp, filesize);
-  Munmap(srcp, filesize); 
+  // 클라이언트에게 응답 바디 전송: 커널이 파일에서 소켓으로 바로 복사 (offset을 따로 쓰므로 캐시된 fd 공유 가능)
+  while (offset < filesize) {
+    if ((n = sendfile(fd, srcfd, &offset, filesize - offset)) <= 0) {
+      if (n < 0 && errno == EINTR)
+        continue;
+      break; // 클라이언트가 끊었거나 파일이 줄어듦
+    }
+  }
 }
 
 void get_filetype(char *filename, char *filetype) 
@@ -193,18 +415,40 @@ void get_filetype(char *filename, char *filetype)
 
 void serve_dynamic(int fd, char *filename, char *cgiargs) 
 {
-  char buf[MAXLINE], *emptylist[] = { NULL };
+  char buf[MAXLINE], *emptylist[] = { NULL }, **envp, *query;
+  pid_t pid;
+  int n = 0;
+
+  // 자식에게 줄 환경 변수(QUERY_STRING + 기존 환경)를 fork 전에 만듦
+  // 동시 모드에서는 fork한 자식에 호출한 스레드만 남으므로, 다른 스레드가 잡고 있던 malloc 락에 걸릴 수 있는
+  // setenv() 대신 자식에서는 dup2()와 execve()만 부른다
+  while (environ[n])
+    n++;
+  envp = Malloc((n + 2) * sizeof(char *));
+  query = Malloc(strlen("QUERY_STRING=") + strlen(cgiargs) + 1);
+  sprintf(query, "QUERY_STRING=%s", cgiargs);
+  envp[0] = query;
+  n = 1;
+  for (char **e = environ; *e; e++)
+    if (strncmp(*e, "QUERY_STRING=", 13))
+      envp[n++] = *e;
+  envp[n] = NULL;
 
   // 클라이언트에게 HTTP 응답의 첫 번째 부분 반환
   sprintf(buf, "HTTP/1.0 200 OK\r\n");
-  Rio_writen(fd, buf, strlen(buf));
+  rio_writen(fd, buf, strlen(buf));
   sprintf(buf, "Server: Tiny Web Server\r\n");
-  Rio_writen(fd, buf, strlen(buf));
+  rio_writen(fd, buf, strlen(buf));
 
-  if (Fork() == 0) { // 자식 프로세스
-    setenv("QUERY_STRING", cgiargs, 1);
-    Dup2(fd, STDOUT_FILENO); // 클라이언트에게 표준 출력 리다이렉트
-    Execve(filename, emptylist, environ); // CGI 프로그램 실행
+  if ((pid = fork()) == 0) { // 자식 프로세스
+    if (dup2(fd, STDOUT_FILENO) >= 0) // 클라이언트에게 표준 출력 리다이렉트
+      execve(filename, emptylist, envp); // CGI 프로그램 실행
+    _exit(127); // 부모의 stdio 버퍼나 atexit 처리를 건드리지 않고 끝냄
   }
-  Wait(NULL); // 자식 프로세스 종료 대기
-}
\ No newline at end of file
+  if (pid < 0)
+    fprintf(stderr, "fork error: %s\n", strerror(errno));
+  else
+    waitpid(pid, NULL, 0); // 이 요청의 자식만 기다림 (동시 모드에서 다른 스레드의 자식을 거두지 않도록)
+  free(query);
+  free(envp);
+}
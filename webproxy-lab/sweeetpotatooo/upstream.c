@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <netinet/tcp.h>
+#include "csapp.h"
+#include "upstream.h"
+#include "resolver.h"
+
+#define POOL_BUCKETS 64 // 호스트 해시 버킷 수
+
+// (host, port) 하나의 유휴 연결 목록. 가장 최근에 반납된 연결이 앞에 온다 (LIFO).
+typedef struct pool_host
+{
+  char *key;
+  upstream_t *idle;
+  int nidle;
+  struct pool_host *next;
+} pool_host;
+
+static pool_host *buckets[POOL_BUCKETS];
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER; // 풀 조작은 짧으므로 전역 락 하나
+static time_t last_sweep;                                     // 마지막 전체 만료 검사 시각
+
+
+// 풀 흐름
+// upstream_get(): 유휴 연결이 있으면 상태 확인 후 재사용, 없으면 새로 연결
+// upstream_put(): 응답을 끝까지 읽은 keep-alive 연결을 풀에 반납 (호스트당 최대 개수 초과 시 닫음)
+// upstream_close(): 프레이밍을 알 수 없거나 에러가 난 연결은 반납하지 않고 닫음
+// 유휴 시간이 UPSTREAM_IDLE_TIMEOUT을 넘은 연결은 조회/반납 시 정리
+
+
+static unsigned hash_str(const char *s)
+{
+  unsigned h = 5381;
+
+  while (*s)
+    h = h * 33 + (unsigned char)*s++;
+  return h;
+}
+
+// key에 해당하는 호스트 항목 찾기 (없고 create면 생성)
+static pool_host *find_host(const char *key, int create)
+{
+  pool_host **pp = &buckets[hash_str(key) % POOL_BUCKETS];
+  pool_host *h;
+
+  for (h = *pp; h; h = h->next)
+    if (!strcmp(h->key, key))
+      return h;
+  if (!create)
+    return NULL;
+  h = Calloc(1, sizeof(pool_host));
+  h->key = strdup(key);
+  h->next = *pp;
+  *pp = h;
+  return h;
+}
+
+// 호스트 항목에서 유휴 시간이 지난 연결 정리 (pool_lock 보유 상태)
+static void expire_idle(pool_host *h, time_t now)
+{
+  upstream_t **pp = &h->idle, *up;
+
+  while ((up = *pp))
+  {
+    if (now - up->idle_since >= UPSTREAM_IDLE_TIMEOUT)
+    {
+      *pp = up->next;
+      h->nidle--;
+      upstream_close(up);
+    }
+    else
+      pp = &up->next;
+  }
+}
+
+// 재사용 전 상태 확인: 읽을 데이터가 없고(EAGAIN) 연결이 살아 있어야 정상
+// 0바이트(FIN)나 예상치 못한 데이터가 있으면 버린다
+static int is_healthy(upstream_t *up)
+{
+  char c;
+  ssize_t n = recv(up->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+
+  return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+// (hostname, port)로 가는 연결 반환. 풀에 살아 있는 유휴 연결이 있으면 재사용, 없으면 새로 연결
+// 연결 실패 시 NULL
+upstream_t *upstream_get(char *hostname, char *port)
+{
+  char key[MAXLINE];
+  upstream_t *up = NULL;
+  pool_host *h;
+  time_t now = time(NULL);
+  int fd;
+
+  snprintf(key, sizeof(key), "%s:%s", hostname, port);
+
+  pthread_mutex_lock(&pool_lock);
+  // 가끔 전체 호스트를 돌며 오래된 유휴 연결 정리 (더 이상 요청되지 않는 호스트 포함)
+  if (now - last_sweep >= UPSTREAM_IDLE_TIMEOUT)
+  {
+    for (int i = 0; i < POOL_BUCKETS; i++)
+      for (h = buckets[i]; h; h = h->next)
+        expire_idle(h, now);
+    last_sweep = now;
+  }
+  if ((h = find_host(key, 0)))
+  {
+    while ((up = h->idle))
+    {
+      h->idle = up->next;
+      h->nidle--;
+      if (now - up->idle_since < UPSTREAM_IDLE_TIMEOUT && is_healthy(up))
+        break;
+      upstream_close(up);
+    }
+  }
+  pthread_mutex_unlock(&pool_lock);
+
+  if (up)
+  {
+    up->reused = 1;
+    up->next = NULL;
+    return up;
+  }
+
+  // 새 연결 (DNS 캐시를 거치고, 실패해도 프로세스를 종료하지 않음)
+  if ((fd = resolver_connect(hostname, port)) < 0)
+    return NULL;
+  up = Calloc(1, sizeof(upstream_t));
+  up->fd = fd;
+  up->key = strdup(key);
+  rio_readinitb(&up->rio, fd);
+  return up;
+}
+
+// 응답을 끝까지 읽은 연결을 풀에 반납. 버퍼에 남은 데이터가 있거나 호스트당 한도를 넘으면 닫음
+void upstream_put(upstream_t *up)
+{
+  pool_host *h;
+
+  if (up->rio.rio_cnt > 0)
+  {
+    upstream_close(up);
+    return;
+  }
+
+  pthread_mutex_lock(&pool_lock);
+  h = find_host(up->key, 1);
+  expire_idle(h, time(NULL));
+  if (h->nidle >= UPSTREAM_MAX_IDLE_PER_HOST)
+  {
+    pthread_mutex_unlock(&pool_lock);
+    upstream_close(up);
+    return;
+  }
+  up->idle_since = time(NULL);
+  up->reused = 0;
+  up->next = h->idle;
+  h->idle = up;
+  h->nidle++;
+  pthread_mutex_unlock(&pool_lock);
+}
+
+// 연결을 닫고 해제 (풀에 반납하지 않음)
+void upstream_close(upstream_t *up)
+{
+  close(up->fd);
+  free(up->key);
+  free(up);
+}
+
+// 요청을 보낸 뒤 응답을 읽기 전에 호출: 받는 세그먼트마다 바로 ACK하게 한다
+// 재사용한 연결은 quickack 모드를 벗어나 ACK를 지연하는데, 원 서버가 헤더와 바디를 따로 쓰면(Nagle)
+// 헤더의 ACK를 기다리느라 바디가 지연 ACK 시간(약 40ms)만큼 늦게 온다
+void upstream_quickack(upstream_t *up)
+{
+  int one = 1;
+
+  setsockopt(up->fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+}
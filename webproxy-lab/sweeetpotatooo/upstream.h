@@ -0,0 +1,28 @@
+//webproxy-lab/sweeetpotatooo/upstream.h
+#ifndef __UPSTREAM_H__
+#define __UPSTREAM_H__
+
+#include <time.h>
+
+#include "csapp.h"
+
+#define UPSTREAM_MAX_IDLE_PER_HOST 8 // (host, port)마다 보관하는 유휴 연결 최대 수
+#define UPSTREAM_IDLE_TIMEOUT 30     // 유휴 연결 보관 시간 (초)
+
+// 원 서버와의 HTTP/1.1 지속 연결. 응답을 정확히 끝까지 읽은 뒤에만 풀에 반납한다.
+typedef struct upstream
+{
+  int fd;
+  rio_t rio;               // 응답 읽기용 버퍼 (반납 시 남은 데이터가 없어야 함)
+  char *key;               // 풀 키 "host:port"
+  int reused;              // 풀에서 꺼낸 연결이면 1 (서버가 이미 닫았을 수 있어 재시도 대상)
+  time_t idle_since;       // 풀에 들어간 시각
+  struct upstream *next;   // 같은 호스트의 유휴 연결 목록
+} upstream_t;
+
+upstream_t *upstream_get(char *hostname, char *port);
+void upstream_put(upstream_t *up);
+void upstream_close(upstream_t *up);
+void upstream_quickack(upstream_t *up);
+
+#endif /* __UPSTREAM_H__ */